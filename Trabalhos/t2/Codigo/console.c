@@ -14,6 +14,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <time.h>
 #include <assert.h>
 
 // CONSTANTES {{{1
@@ -24,45 +25,90 @@
 #define N_COL 80  // número de colunas na tela
 
 // número de linhas para cada componente da tela
-#define N_TERM        4  // número de terminais, cada um ocupa 2 linhas na tela
-#define N_LIN_TERM    (N_TERM * 2)
+// cada terminal ocupa 2 linhas na tela; são mostrados só os que cabem deixando
+//   pelo menos N_LIN_CONSOLE_MIN linhas para a área geral
 #define N_LIN_STATUS  1
 #define N_LIN_ENTRADA 1
-#define N_LIN_CONSOLE (N_LIN - N_LIN_TERM - N_LIN_STATUS - N_LIN_ENTRADA)
+#define N_LIN_CONSOLE_MIN 4
 
 // linha onde começa cada componente
+// (as demais dependem do número de terminais, ver console_t)
 #define LINHA_TERM    0
-#define LINHA_STATUS  (LINHA_TERM + N_LIN_TERM)
-#define LINHA_CONSOLE (LINHA_STATUS + N_LIN_STATUS)
-#define LINHA_ENTRADA (LINHA_CONSOLE + N_LIN_CONSOLE)
 
 // números de comandos para o controlador que podem ser guardados na console
 #define N_CMD_EXT 10
 
+// número máximo de vezes por segundo que a tela é redesenhada
+#define QUADROS_POR_SEGUNDO 30
+// espera inicial por uma tecla com a simulação parada, em ms (comando D)
+#define ESPERA_TECLADO 5
+
 // DECLARAÇÃO {{{1
 
 struct console_t {
-  terminal_t *term[N_TERM];
-  int cor_txt[N_TERM];
-  int cor_cursor[N_TERM];
+  bool usa_tela;
+  // terminais, e quantos deles aparecem na tela
+  int n_term;
+  int n_term_visiveis;
+  terminal_t **term;
+  int *cor_txt;
+  int *cor_cursor;
+  // linhas onde começa cada componente da tela, e tamanho da área geral
+  int linha_status;
+  int linha_console;
+  int linha_entrada;
+  int n_lin_console;
   char txt_status[N_COL+1];
-  char txt_console[N_LIN_CONSOLE][N_COL+1];
+  // só as n_lin_console primeiras linhas são usadas
+  char txt_console[N_LIN][N_COL+1];
   char txt_entrada[N_COL+1];
   char fila_de_comandos_externos[N_CMD_EXT];
   FILE *arquivo_de_log;
+  // o que mudou desde o último desenho: versão de cada terminal quando foi
+  //   desenhado, e se o status, a área geral e a entrada precisam ser redesenhados
+  unsigned *versao_desenhada;
+  bool mudou_status;
+  bool mudou_console;
+  bool mudou_entrada;
+  // momento do último desenho e da última leitura do teclado, em segundos
+  double t_ultimo_quadro;
+  double t_ultima_leitura;
+  // quanto a leitura do teclado espera por uma tecla (ms), com a simulação
+  //   parada
+  int espera_teclado;
+  // quem produz o texto da linha de status
+  f_status_t f_status;
+  void *arg_status;
 };
 
 // CRIAÇÃO {{{1
 
 static console_t *console_global; // gambiarra para simplificar o uso de prints na console
-console_t *console_cria(void)
+console_t *console_cria(bool usa_tela, int n_terminais)
 {
   console_t *self = malloc(sizeof(*self));
   assert(self != NULL);
   console_global = self;
-
-  for (int t = 0; t < N_TERM; t++) {
+  self->usa_tela = usa_tela;
+
+  assert(n_terminais > 0 && n_terminais <= MAX_TERMINAIS);
+  self->n_term = n_terminais;
+  int max_visiveis = (N_LIN - N_LIN_STATUS - N_LIN_ENTRADA - N_LIN_CONSOLE_MIN) / 2;
+  self->n_term_visiveis = n_terminais < max_visiveis ? n_terminais : max_visiveis;
+  self->linha_status = LINHA_TERM + self->n_term_visiveis * 2;
+  self->linha_console = self->linha_status + N_LIN_STATUS;
+  self->n_lin_console = N_LIN - self->linha_console - N_LIN_ENTRADA;
+  self->linha_entrada = self->linha_console + self->n_lin_console;
+
+  self->term = malloc(n_terminais * sizeof(*self->term));
+  self->cor_txt = malloc(n_terminais * sizeof(*self->cor_txt));
+  self->cor_cursor = malloc(n_terminais * sizeof(*self->cor_cursor));
+  self->versao_desenhada = malloc(n_terminais * sizeof(*self->versao_desenhada));
+  assert(self->term != NULL && self->cor_txt != NULL && self->cor_cursor != NULL
+         && self->versao_desenhada != NULL);
+  for (int t = 0; t < n_terminais; t++) {
     self->term[t] = terminal_cria(N_COL);
+    self->versao_desenhada[t] = terminal_versao(self->term[t]) - 1;
     if ((t % 2) == 0) {
       self->cor_txt[t] = COR_TXT_PAR;
       self->cor_cursor[t] = COR_CURSOR_PAR;
@@ -71,34 +117,50 @@ console_t *console_cria(void)
       self->cor_cursor[t] = COR_CURSOR_IMPAR;
     }
   }
-  for (int l = 0; l < N_LIN_CONSOLE; l++) {
+  for (int l = 0; l < N_LIN; l++) {
     strcpy(self->txt_console[l], "");
   }
   strcpy(self->txt_entrada, "");
+  strcpy(self->txt_status, "");
   self->fila_de_comandos_externos[0] = '\0';
   self->arquivo_de_log = fopen("log_da_console", "w");
+  self->mudou_status = true;
+  self->mudou_console = true;
+  self->mudou_entrada = true;
+  self->t_ultimo_quadro = 0;
+  self->t_ultima_leitura = 0;
+  self->espera_teclado = ESPERA_TECLADO;
+  self->f_status = NULL;
+  self->arg_status = NULL;
 
-  tela_init();
+  if (self->usa_tela) tela_init();
 
   return self;
 }
 
-static void console_desenha(console_t *self);
+static void desenha(console_t *self, bool mesmo_sem_tempo);
 
 void console_destroi(console_t *self)
 {
-  console_desenha(self);
+  desenha(self, true);
   if (self->arquivo_de_log != NULL) fclose(self->arquivo_de_log);
-  tela_puts(COR_OCUPADO, "  digite ENTER para sair  ");
-  tela_atualiza();
-  while (tela_tecla() != '\n') {
-    ;
+  if (self->usa_tela) {
+    tela_puts(COR_OCUPADO, "  digite ENTER para sair  ");
+    tela_atualiza();
+    tela_espera(self->espera_teclado);
+    while (tela_tecla() != '\n') {
+      ;
+    }
+    tela_fim();
   }
-  tela_fim();
 
-  for (int t = 0; t < N_TERM; t++) {
+  for (int t = 0; t < self->n_term; t++) {
     terminal_destroi(self->term[t]);
   }
+  free(self->term);
+  free(self->cor_txt);
+  free(self->cor_cursor);
+  free(self->versao_desenhada);
   free(self);
   return;
 }
@@ -108,13 +170,13 @@ void console_destroi(console_t *self)
 terminal_t *console_terminal(console_t *self, char id_terminal)
 {
   int num_terminal = tolower(id_terminal) - 'a';
-  if (num_terminal < 0 || num_terminal >= N_TERM) return NULL;
+  if (num_terminal < 0 || num_terminal >= self->n_term) return NULL;
   return self->term[num_terminal];
 }
 
 static void atualiza_terminais(console_t *self)
 {
-  for (int t = 0; t < N_TERM; t++) {
+  for (int t = 0; t < self->n_term; t++) {
     terminal_tictac(self->term[t]);
   }
 }
@@ -145,16 +207,34 @@ static void limpa_saida_do_terminal(console_t *self, char id_terminal)
   terminal_limpa_saida(terminal);
 }
 
+// mostra na console as 'n' últimas linhas de saída do terminal, a mais
+//   antiga primeiro
+static void mostra_historico_do_terminal(console_t *self, char id_terminal, int n)
+{
+  terminal_t *terminal = console_terminal(self, id_terminal);
+  if (terminal == NULL) {
+    console_printf("Terminal '%c' inválido\n", id_terminal);
+    return;
+  }
+  if (n <= 0) n = self->n_lin_console - 1;
+  for (int l = n - 1; l >= 0; l--) {
+    char *linha = terminal_txt_historico(terminal, l);
+    if (linha != NULL) console_printf("%c| %s", toupper(id_terminal), linha);
+  }
+}
+
 // SAÍDA {{{1
 
 static void insere_string_na_console(console_t *self, char *s)
 {
-  for(int l=0; l<N_LIN_CONSOLE-1; l++) {
+  int n_lin = self->n_lin_console;
+  for(int l=0; l<n_lin-1; l++) {
     strncpy(self->txt_console[l], self->txt_console[l+1], N_COL);
     self->txt_console[l][N_COL] = '\0'; // quem definiu strncpy é estúpido!
   }
-  strncpy(self->txt_console[N_LIN_CONSOLE-1], s, N_COL);
-  self->txt_console[N_LIN_CONSOLE-1][N_COL] = '\0'; // grrrr
+  strncpy(self->txt_console[n_lin-1], s, N_COL);
+  self->txt_console[n_lin-1][N_COL] = '\0'; // grrrr
+  self->mudou_console = true;
   if (self->arquivo_de_log != NULL) {
     fprintf(self->arquivo_de_log, "%s\n", s);
   }
@@ -178,7 +258,36 @@ static void insere_strings_na_console(console_t *self, char *s)
 void console_print_status(console_t *self, char *txt)
 {
   // imprime alinhado a esquerda ("-"), max N_COL chars ("*")
-  sprintf(self->txt_status, "%-*s", N_COL, txt);
+  char novo[sizeof(self->txt_status)];
+  snprintf(novo, sizeof(novo), "%-*s", N_COL, txt);
+  if (strcmp(novo, self->txt_status) != 0) {
+    strcpy(self->txt_status, novo);
+    self->mudou_status = true;
+  }
+  // sem tela, o status só aparece no log
+  if (!self->usa_tela && self->arquivo_de_log != NULL) {
+    fprintf(self->arquivo_de_log, "STATUS: %s\n", txt);
+  }
+}
+
+static void atualiza_status(console_t *self);
+
+void console_define_status(console_t *self, f_status_t f, void *arg)
+{
+  // o último texto da função anterior continua na tela (sem tela, ele já
+  //   foi para o log)
+  if (self->usa_tela) atualiza_status(self);
+  self->f_status = f;
+  self->arg_status = arg;
+}
+
+// pede o texto do status para a função definida em console_define_status
+static void atualiza_status(console_t *self)
+{
+  if (self->f_status == NULL) return;
+  char txt[TAM_STATUS] = "";
+  self->f_status(self->arg_status, txt);
+  console_print_status(self, txt);
 }
 
 int console_printf(char *formato, ...)
@@ -222,6 +331,7 @@ static void interpreta_linha_entrada(console_t *self)
   // Comandos aceitos:
   // Etstr entra a string 'str' no terminal 't'  ex: eb30
   // Zt    esvazia a saída do terminal 't'  ex: za
+  // Htn   mostra as últimas 'n' linhas de saída do terminal 't'  ex: hb10
   // Dn    altera o tempo de espera do teclado  ex: d0  -> modo turbo
   // P     para a execução
   // 1     executa uma instrução
@@ -239,9 +349,12 @@ static void interpreta_linha_entrada(console_t *self)
     case 'Z':
       limpa_saida_do_terminal(self, linha[1]);
       break;
+    case 'H':
+      mostra_historico_do_terminal(self, linha[1], atoi(&linha[2]));
+      break;
     case 'D':
       val = atoi(&linha[1]);
-      tela_espera(val);
+      self->espera_teclado = val;
       break;
     case 'P':
     case '1':
@@ -253,11 +366,20 @@ static void interpreta_linha_entrada(console_t *self)
       console_printf("Comando '%c' não reconhecido", cmd);
   }
   strcpy(self->txt_entrada, "");
+  self->mudou_entrada = true;
 }
 
+static bool passou_tempo_do_quadro(double *pt_ultimo);
+
 // lê e guarda um caractere do teclado; interpreta linha se for 'enter'
-static void verifica_entrada(console_t *self)
+// com a simulação executando, o teclado é lido no máximo uma vez por quadro,
+//   sem esperar; parada, a leitura espera um pouco por uma tecla, para o
+//   controlador não ocupar a CPU à toa
+static void verifica_entrada(console_t *self, bool executando)
 {
+  if (!self->usa_tela) return;
+  if (executando && !passou_tempo_do_quadro(&self->t_ultima_leitura)) return;
+  tela_espera(executando ? 0 : self->espera_teclado);
   char ch = tela_tecla();
 
   int l = strlen(self->txt_entrada);
@@ -265,18 +387,20 @@ static void verifica_entrada(console_t *self)
   if (ch == '\b' || ch == 127) {   // backspace ou del
     if (l > 0) {
       self->txt_entrada[l - 1] = '\0';
+      self->mudou_entrada = true;
     }
   } else if (ch == '\n') {
     interpreta_linha_entrada(self);
   } else if (ch >= ' ' && ch < 127 && l < N_COL) {
     self->txt_entrada[l] = ch;
     self->txt_entrada[l+1] = '\0';
+    self->mudou_entrada = true;
   } // senão, ignora o caractere digitado
 }
 
-char console_comando_externo(console_t *self)
+char console_comando_externo(console_t *self, bool executando)
 {
-  verifica_entrada(self);
+  verifica_entrada(self, executando);
   return remove_comando_externo(self);
 }
 
@@ -290,29 +414,36 @@ static void desenha_linha_terminal(char *txt, int linha, int cor_txt, int cor_cu
   tela_puts(cor_cursor, " ");
 }
 
-static void desenha_terminais(console_t *self)
+// desenha os terminais que mudaram; retorna true se desenhou algum
+static bool desenha_terminais(console_t *self)
 {
-  for (int t = 0; t < N_TERM; t++) {
+  bool desenhou = false;
+  for (int t = 0; t < self->n_term_visiveis; t++) {
     terminal_t *terminal = self->term[t];
+    unsigned versao = terminal_versao(terminal);
+    if (versao == self->versao_desenhada[t]) continue;
+    self->versao_desenhada[t] = versao;
+    desenhou = true;
     int cor_txt = self->cor_txt[t];
     int cor_cursor = self->cor_cursor[t];
     int linha = LINHA_TERM + t * 2;
     desenha_linha_terminal(terminal_txt_entrada(terminal), linha, cor_txt, cor_cursor);
     desenha_linha_terminal(terminal_txt_saida(terminal), linha+1, cor_txt, cor_cursor);
   }
+  return desenhou;
 }
 
 static void desenha_status(console_t *self)
 {
-  tela_posiciona(LINHA_STATUS, 0);
+  tela_posiciona(self->linha_status, 0);
   tela_puts(COR_STATUS, self->txt_status);
   tela_limpa_linha();
 }
 
 static void desenha_console(console_t *self)
 {
-  for (int l=0; l<N_LIN_CONSOLE; l++) {
-    tela_posiciona(LINHA_CONSOLE + l, 0);
+  for (int l=0; l<self->n_lin_console; l++) {
+    tela_posiciona(self->linha_console + l, 0);
     tela_puts(COR_CONSOLE, self->txt_console[l]);
     tela_limpa_linha();
   }
@@ -321,32 +452,128 @@ static void desenha_console(console_t *self)
 static void desenha_entrada(console_t *self)
 {
   char txt_fixo[] = "P=para C=continua 1=passo F=fim  Ets=entra Zt=zera";
-  tela_posiciona(LINHA_ENTRADA, 0);
+  tela_posiciona(self->linha_entrada, 0);
   tela_puts(COR_ENTRADA, ""); // gambiarra para limpar na cor certa
   tela_limpa_linha();
-  tela_posiciona(LINHA_ENTRADA, N_COL - sizeof(txt_fixo));
+  tela_posiciona(self->linha_entrada, N_COL - sizeof(txt_fixo));
   tela_puts(COR_ENTRADA, txt_fixo);
-  tela_posiciona(LINHA_ENTRADA, 0);
+  tela_posiciona(self->linha_entrada, 0);
   tela_puts(COR_ENTRADA, self->txt_entrada);
 }
 
-static void console_desenha(console_t *self)
+// retorna true se já passou o tempo de um quadro desde o momento em
+//   '*pt_ultimo', que passa a ser agora
+static bool passou_tempo_do_quadro(double *pt_ultimo)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  double agora = ts.tv_sec + ts.tv_nsec * 1e-9;
+  if (agora - *pt_ultimo < 1.0 / QUADROS_POR_SEGUNDO) return false;
+  *pt_ultimo = agora;
+  return true;
+}
+
+// redesenha só as partes da tela que mudaram, no máximo QUADROS_POR_SEGUNDO
+//   vezes por segundo (a menos que 'mesmo_sem_tempo')
+static void desenha(console_t *self, bool mesmo_sem_tempo)
+{
+  if (!self->usa_tela) return;
+  if (!mesmo_sem_tempo && !passou_tempo_do_quadro(&self->t_ultimo_quadro)) return;
+
+  atualiza_status(self);
+  bool desenhou = desenha_terminais(self);
+  if (self->mudou_status) {
+    desenha_status(self);
+    self->mudou_status = false;
+    desenhou = true;
+  }
+  if (self->mudou_console) {
+    desenha_console(self);
+    self->mudou_console = false;
+    desenhou = true;
+  }
+  // a entrada é desenhada por último porque deixa o cursor na posição dela
+  if (desenhou || self->mudou_entrada) {
+    desenha_entrada(self);
+    self->mudou_entrada = false;
+    // faz aparecer tudo que foi desenhado
+    tela_atualiza();
+  }
+}
+
+void console_desenha(console_t *self)
 {
-  desenha_terminais(self);
-  desenha_status(self);
-  desenha_console(self);
-  desenha_entrada(self);
+  // sem tela, o status vai para o log a cada chamada
+  if (!self->usa_tela) atualiza_status(self);
+  desenha(self, false);
+}
 
-  // faz aparecer tudo que foi desenhado
-  tela_atualiza();
+// INTERRUPÇÕES DOS TERMINAIS {{{1
+
+irq_t console_interrupcao(console_t *self)
+{
+  for (int t = 0; t < self->n_term; t++) {
+    if (terminal_interrupcao(self->term[t], IRQ_TECLADO)) return IRQ_TECLADO;
+    if (terminal_interrupcao(self->term[t], IRQ_TELA)) return IRQ_TELA;
+  }
+  return N_IRQ;
+}
+
+static irq_t irq_do_dispositivo(int id)
+{
+  return id == 0 ? IRQ_TECLADO : IRQ_TELA;
+}
+
+err_t console_leitura(void *disp, int id, int *pvalor)
+{
+  console_t *self = disp;
+  if (id < 0 || id > 1) return ERR_DISP_INV;
+  irq_t irq = irq_do_dispositivo(id);
+  int mapa = 0;
+  for (int t = 0; t < self->n_term; t++) {
+    if (terminal_interrupcao(self->term[t], irq)) mapa |= 1 << t;
+  }
+  *pvalor = mapa;
+  return ERR_OK;
+}
+
+err_t console_escrita(void *disp, int id, int valor)
+{
+  console_t *self = disp;
+  if (id < 0 || id > 1) return ERR_DISP_INV;
+  irq_t irq = irq_do_dispositivo(id);
+  for (int t = 0; t < self->n_term; t++) {
+    if (valor & (1 << t)) terminal_reconhece_interrupcao(self->term[t], irq);
+  }
+  return ERR_OK;
+}
+
+int console_n_terminais(console_t *self)
+{
+  return self->n_term;
 }
 
 // TICTAC {{{1
 void console_tictac(console_t *self)
 {
-  verifica_entrada(self);
   atualiza_terminais(self);
-  console_desenha(self);
+}
+
+void console_avanca(console_t *self, int n)
+{
+  for (int t = 0; t < self->n_term; t++) {
+    terminal_avanca(self->term[t], n);
+  }
+}
+
+int console_tempo_ate_evento(console_t *self)
+{
+  int menor = 0;
+  for (int t = 0; t < self->n_term; t++) {
+    int tempo = terminal_tempo_ate_evento(self->term[t]);
+    if (tempo > 0 && (menor == 0 || tempo < menor)) menor = tempo;
+  }
+  return menor;
 }
 
 // vim: foldmethod=marker
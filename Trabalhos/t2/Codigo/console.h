@@ -11,8 +11,13 @@
 
 typedef struct console_t console_t;
 
-// cria e inicializa a console
-console_t *console_cria(void);
+// cria e inicializa a console, com 'n_terminais' terminais (A, B, ...; no
+//   máximo MAX_TERMINAIS); se não couberem todos na tela, só os primeiros
+//   aparecem, mas todos funcionam
+// se 'usa_tela' for false, a console não usa o terminal físico (modo lote):
+//   não desenha nada, não lê comandos do operador, e o que for impresso na
+//   área geral e na linha de status vai só para o arquivo de log
+console_t *console_cria(bool usa_tela, int n_terminais);
 
 // destrói a console
 void console_destroi(console_t *self);
@@ -23,6 +28,18 @@ int console_printf(char *fmt, ...);
 // imprime na linha de status
 void console_print_status(console_t *self, char *txt);
 
+// função que escreve em 'txt' o texto da linha de status, com no máximo
+//   TAM_STATUS-1 caracteres
+#define TAM_STATUS 100
+typedef void (*f_status_t)(void *arg, char *txt);
+
+// define a função que produz o texto da linha de status (NULL para nenhuma)
+// a função só é chamada quando o status vai ser mostrado: quando a tela é
+//   redesenhada, ou, sem tela, a cada console_desenha; assim o texto não é
+//   formatado quando ninguém vai ver
+// ao trocar a função, o status fica com o último texto da anterior
+void console_define_status(console_t *self, f_status_t f, void *arg);
+
 // retorna o próximo comando externo digitado pelo operador na console.
 // um comando externo é representado por um caractere, e não é executado internamente
 //   na console (é executado pelo controlador).
@@ -32,12 +49,45 @@ void console_print_status(console_t *self, char *txt);
 //   'C': continua a execução,
 //   'F': finaliza a simulação.
 // retorna '\0' caso não tenha comando externo digitado
-char console_comando_externo(console_t *self);
+// se 'executando' (a simulação está em execução contínua), o teclado só é
+//   lido se já passou o tempo de um quadro desde a última leitura, e sem
+//   esperar; senão, a leitura espera um pouco por uma tecla (comando D)
+char console_comando_externo(console_t *self, bool executando);
 
-// retorna o terminal identificado ('A', 'B', etc)
+// retorna o terminal identificado ('A', 'B', etc), ou NULL se não existir
 terminal_t *console_terminal(console_t *self, char id_terminal);
 
-// esta função deve ser chamada periodicamente para que tela funcione
+// retorna o número de terminais
+int console_n_terminais(console_t *self);
+
+// retorna uma interrupção pendente em algum terminal (IRQ_TECLADO ou IRQ_TELA),
+//   ou N_IRQ se não houver
+irq_t console_interrupcao(console_t *self);
+
+// controle das interrupções dos terminais pelo controlador de E/S (ver es.h)
+// id 0 é o teclado, id 1 é a tela
+// a leitura produz um mapa de bits com os terminais que têm a interrupção
+//   pendente (bit 0 para o terminal A, bit 1 para o B etc; por isso o limite
+//   de MAX_TERMINAIS)
+// a escrita reconhece a interrupção dos terminais cujos bits estão ligados
+err_t console_leitura(void *disp, int id, int *pvalor);
+err_t console_escrita(void *disp, int id, int valor);
+
+// esta função deve ser chamada periodicamente para que os terminais funcionem
 void console_tictac(console_t *self);
 
+// equivale a chamar console_tictac 'n' vezes
+void console_avanca(console_t *self, int n);
+
+// retorna o tempo (em chamadas a console_tictac) até o próximo evento em um
+//   terminal que não depende do operador, 0 se não tem (ver
+//   terminal_tempo_ate_evento)
+int console_tempo_ate_evento(console_t *self);
+
+// redesenha as partes da tela que mudaram desde o último desenho (não faz
+//   nada se a console não usa a tela)
+// para não gastar tempo demais com a tela, chamadas muito próximas (menos de
+//   um quadro de intervalo) são ignoradas; o que mudou é desenhado depois
+void console_desenha(console_t *self);
+
 #endif // CONSOLE_H
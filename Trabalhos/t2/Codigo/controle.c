@@ -15,11 +15,26 @@ struct controle_t {
   relogio_t *relogio;
   console_t *console;
   enum { executando, passo, parado, fim } estado;
+  // em modo lote não tem operador; a simulação termina sozinha
+  bool modo_lote;
+  long max_instrucoes;
+  long n_instrucoes;
+  // a console é atualizada a cada 'intervalo_atualizacao' instruções
+  int intervalo_atualizacao;
+  int instrucoes_sem_atualizar;
 };
 
+// número máximo de instruções executadas de uma vez
+#define MAX_BLOCO 1000
+
 // funções auxiliares
 static void controle_processa_comandos_da_console(controle_t *self);
-static void controle_atualiza_estado_na_console(controle_t *self);
+static void controle_descreve_estado(void *arg, char *status);
+static void controle_verifica_fim_do_lote(controle_t *self);
+static void controle_atualiza_console(controle_t *self, int n);
+static int controle_tamanho_do_bloco(controle_t *self);
+static int controle_tempo_ocioso(controle_t *self);
+static void controle_verifica_interrupcoes(controle_t *self);
 
 
 controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio)
@@ -31,47 +46,181 @@ controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio)
   self->console = console;
   self->relogio = relogio;
   self->estado = parado;
+  self->modo_lote = false;
+  self->max_instrucoes = 0;
+  self->n_instrucoes = 0;
+  self->intervalo_atualizacao = 1;
+  self->instrucoes_sem_atualizar = 0;
+
+  // a linha de status só é montada quando a console vai mostrá-la
+  console_define_status(console, controle_descreve_estado, self);
 
   return self;
 }
 
 void controle_destroi(controle_t *self)
 {
+  console_define_status(self->console, NULL, NULL);
   free(self);
 }
 
+void controle_define_modo_lote(controle_t *self, long max_instrucoes)
+{
+  self->modo_lote = true;
+  self->max_instrucoes = max_instrucoes;
+  self->estado = executando;
+}
+
+void controle_define_intervalo_de_atualizacao(controle_t *self, int intervalo)
+{
+  self->intervalo_atualizacao = intervalo;
+}
+
 void controle_laco(controle_t *self)
 {
-  // executa uma instrução por vez até a console dizer que chega
+  // executa instruções até a console dizer que chega
+  // em passo, executa uma instrução por vez; executando, executa blocos de
+  //   instruções, limitados pelo próximo evento (interrupção do relógio,
+  //   evento nos terminais, atualização da console, fim do lote)
   do {
-    if (self->estado == passo || self->estado == executando) {
+    int n = 0;
+    if (self->estado == passo) {
       cpu_executa_1(self->cpu);
-      relogio_tictac(self->relogio);
-
-      if (self->estado == passo) self->estado = parado;
-
-      // enquanto não tem controlador de interrupção, fala direto com o relógio
-      // o dispositivo 3 do relógio contém 1 se o timer expirou
-      int tem_int;
-      relogio_leitura(self->relogio, 3, &tem_int);
-      if (tem_int != 0) {
-        cpu_interrompe(self->cpu, IRQ_RELOGIO);
-      }
+      n = 1;
+      self->estado = parado;
+    } else if (self->estado == executando) {
+      n = cpu_executa_n(self->cpu, controle_tamanho_do_bloco(self));
+      // CPU parada: o tempo passa mesmo assim; como nada pode acordá-la
+      //   antes do próximo evento, o relógio avança direto até ele
+      if (n == 0) n = cpu_parada(self->cpu) ? controle_tempo_ocioso(self) : 1;
+    }
+    if (n > 0) {
+      relogio_avanca(self->relogio, n);
+      console_avanca(self->console, n);
+      self->n_instrucoes += n;
+
+      controle_verifica_interrupcoes(self);
+    } else {
+      console_tictac(self->console);
     }
-    console_tictac(self->console);
 
-    controle_processa_comandos_da_console(self);
-    controle_atualiza_estado_na_console(self);
+    if (self->modo_lote) {
+      controle_verifica_fim_do_lote(self);
+    }
+    controle_atualiza_console(self, n);
   } while (self->estado != fim);
 
   console_printf("Fim da execução.");
   console_printf("relógio: %d\n", relogio_agora(self->relogio));
 }
- 
+
+// enquanto não tem controlador de interrupção, fala direto com os dispositivos
+// o relógio tem prioridade; os terminais são consultados pela console
+// retorna a interrupção pendente, ou N_IRQ se não tiver
+static irq_t controle_interrupcao_pendente(controle_t *self)
+{
+  // o dispositivo 3 do relógio contém 1 se o timer expirou
+  int tem_int;
+  relogio_leitura(self->relogio, 3, &tem_int);
+  if (tem_int != 0) return IRQ_RELOGIO;
+  return console_interrupcao(self->console);
+}
+
+// interrompe a CPU se algum dispositivo tem interrupção pendente
+// a interrupção continua pendente até o SO reconhecer; se a CPU não aceitar
+//   agora, vai ser tentado de novo
+static void controle_verifica_interrupcoes(controle_t *self)
+{
+  irq_t irq = controle_interrupcao_pendente(self);
+  if (irq != N_IRQ) {
+    cpu_interrompe(self->cpu, irq);
+  }
+}
+
+// calcula quantas instruções podem ser executadas antes do próximo evento
+//   que precisa da atenção do controle
+static int controle_tamanho_do_bloco(controle_t *self)
+{
+  long n = MAX_BLOCO;
+  int t_ate_int;
+  // interrupção pendente, que a CPU ainda não aceitou: tenta de novo após a
+  //   próxima instrução
+  if (controle_interrupcao_pendente(self) != N_IRQ) return 1;
+  relogio_leitura(self->relogio, 2, &t_ate_int);
+  if (t_ate_int > 0 && t_ate_int < n) n = t_ate_int;
+  int t_ate_evento = console_tempo_ate_evento(self->console);
+  if (t_ate_evento > 0 && t_ate_evento < n) n = t_ate_evento;
+  if (self->intervalo_atualizacao > 0) {
+    int falta = self->intervalo_atualizacao - self->instrucoes_sem_atualizar;
+    if (falta < n) n = falta;
+  }
+  if (self->max_instrucoes > 0) {
+    long falta = self->max_instrucoes - self->n_instrucoes;
+    if (falta < n) n = falta;
+  }
+  if (n < 1) n = 1;
+  return n;
+}
+
+// com a CPU parada, calcula o tempo até o próximo evento que pode acordá-la
+//   (interrupção do relógio ou de um terminal), limitado pelo fim do lote
+// a atualização da console não limita, a CPU parada não muda; se não tem
+//   evento previsto, só o operador pode acordar a CPU, e o tempo passa de 1 em 1
+static int controle_tempo_ocioso(controle_t *self)
+{
+  if (controle_interrupcao_pendente(self) != N_IRQ) return 1;
+  long n = 0;
+  int t_ate_int;
+  relogio_leitura(self->relogio, 2, &t_ate_int);
+  if (t_ate_int > 0) n = t_ate_int;
+  int t_ate_evento = console_tempo_ate_evento(self->console);
+  if (t_ate_evento > 0 && (n == 0 || t_ate_evento < n)) n = t_ate_evento;
+  if (self->max_instrucoes > 0) {
+    long falta = self->max_instrucoes - self->n_instrucoes;
+    if (falta < n) n = falta;
+  }
+  if (n < 1) n = 1;
+  return n;
+}
+
+// em modo lote, a simulação termina quando não tem mais o que fazer: a CPU
+//   está parada e não tem interrupção do relógio para acordá-la
+static void controle_verifica_fim_do_lote(controle_t *self)
+{
+  if (self->max_instrucoes > 0 && self->n_instrucoes >= self->max_instrucoes) {
+    console_printf("Limite de %ld instruções atingido.", self->max_instrucoes);
+    self->estado = fim;
+    return;
+  }
+  if (!cpu_parada(self->cpu)) return;
+  int t_ate_int, tem_int;
+  relogio_leitura(self->relogio, 2, &t_ate_int);
+  relogio_leitura(self->relogio, 3, &tem_int);
+  if (t_ate_int == 0 && tem_int == 0) {
+    self->estado = fim;
+  }
+}
+
+// atualiza a console se for o momento
+// só limita a frequência das atualizações durante a execução contínua; parado,
+//   a console é atualizada sempre, para atender o operador
+static void controle_atualiza_console(controle_t *self, int n)
+{
+  if (self->estado == executando) {
+    if (self->intervalo_atualizacao <= 0) return;
+    self->instrucoes_sem_atualizar += n;
+    if (self->instrucoes_sem_atualizar < self->intervalo_atualizacao) return;
+  }
+  self->instrucoes_sem_atualizar = 0;
+  if (!self->modo_lote) {
+    controle_processa_comandos_da_console(self);
+  }
+  console_desenha(self->console);
+}
 
 static void controle_processa_comandos_da_console(controle_t *self)
 {
-  char cmd = console_comando_externo(self->console);
+  char cmd = console_comando_externo(self->console, self->estado == executando);
   switch (cmd) {
     case 'F':
       self->estado = fim;
@@ -88,9 +237,10 @@ static void controle_processa_comandos_da_console(controle_t *self)
   }
 }
 
-static void controle_atualiza_estado_na_console(controle_t *self)
+// produz o texto da linha de status (ver console_define_status)
+static void controle_descreve_estado(void *arg, char *status)
 {
-  char status[100];
+  controle_t *self = arg;
   switch (self->estado) {
     case fim:        strcpy(status, "FIM    | "); break;
     case parado:     strcpy(status, "PARADO | "); break;
@@ -98,5 +248,4 @@ static void controle_atualiza_estado_na_console(controle_t *self)
     case passo:      strcpy(status, "PASSO  | "); break;
   }
   cpu_concatena_descricao(self->cpu, status);
-  console_print_status(self->console, status);
 }
@@ -15,6 +15,17 @@ typedef struct controle_t controle_t;
 controle_t *controle_cria(cpu_t *cpu, console_t *console, relogio_t *relogio);
 void controle_destroi(controle_t *self);
 
+// coloca o controlador em modo lote: a execução começa sem esperar comando
+//   do operador, e termina quando a CPU estiver parada sem ter interrupção
+//   do relógio programada, ou depois de executar 'max_instrucoes' instruções
+//   (0 para não ter limite)
+void controle_define_modo_lote(controle_t *self, long max_instrucoes);
+
+// define a cada quantas instruções a console é atualizada (redesenho da tela,
+//   leitura dos comandos do operador e registro do estado da CPU)
+// 0 significa nunca (só faz sentido em modo lote); o padrão é 1
+void controle_define_intervalo_de_atualizacao(controle_t *self, int intervalo);
+
 // o laço principal da simulação
 void controle_laco(controle_t *self);
 
@@ -15,6 +15,64 @@
 #include <assert.h>
 
 // DECLARAÇÃO {{{1
+// função que implementa uma instrução, recebe o argumento da instrução
+typedef void (*operacao_t)(cpu_t *self, int A1);
+
+// uma instrução decodificada, como é mantida no cache de instruções
+typedef struct {
+  // versão do quadro que continha a instrução quando foi decodificada
+  //   (a decodificação só vale enquanto o quadro tiver essa versão; 0 = vazio)
+  unsigned versao;
+  int opcode;
+  int n_args;
+  int A1;
+  bool privilegiada;
+  // se a instrução acessa dispositivos de E/S (diretamente ou pelo SO)
+  bool acessa_es;
+  // função que implementa a instrução
+  operacao_t op;
+} instr_decod_t;
+
+// Cache de blocos básicos
+// Um bloco básico é uma sequência de instruções em um mesmo quadro, executadas
+//   sempre em ordem, terminada por um desvio (DESV*, CHAMA, RET), por uma
+//   instrução que não pode ir para um bloco (privilegiada, de E/S, CHAMAS) ou
+//   pelo fim do quadro. As instruções do bloco são agrupadas em passos, e um
+//   passo é executado com uma só chamada; os passos mais comuns nos programas
+//   são superinstruções, com a execução das instruções que o compõem
+//   implementada em uma só função.
+// O cache é de mapeamento direto, pelo endereço físico do início do bloco, e
+//   a validade de um bloco é controlada pela versão do quadro, como no cache de
+//   instruções decodificadas.
+#define N_BLOCOS 1024
+// número máximo de instruções em um passo
+#define MAX_FUSAO 3
+
+typedef struct passo_t passo_t;
+// função que executa um passo, retorna o número de instruções executadas
+//   (se uma instrução causar erro, ela é contada e as seguintes não executam)
+typedef int (*f_passo_t)(cpu_t *self, passo_t *passo);
+
+struct passo_t {
+  f_passo_t executa;
+  int n_instr;
+  // se a última instrução do passo escreve na memória (só pode ser a última,
+  //   porque a escrita pode alterar o código do próprio bloco)
+  bool escreve;
+  operacao_t op[MAX_FUSAO];
+  int A1[MAX_FUSAO];
+};
+
+typedef struct {
+  // endereço físico da primeira instrução, e versão do quadro quando o bloco
+  //   foi montado (0 = vazio)
+  int endfis;
+  unsigned versao;
+  // um bloco sem passos indica que a instrução no início não vai para blocos
+  int n_passos;
+  passo_t passos[TAM_PAGINA];
+} bloco_t;
+
 // uma CPU tem estado, memória, controlador de ES
 struct cpu_t {
   // registradores
@@ -33,6 +91,18 @@ struct cpu_t {
   // função e argumento para implementar instrução CHAMAC
   func_chamaC_t funcaoC;
   void *argC;
+  // cache de instruções decodificadas, uma por endereço físico da memória
+  instr_decod_t *decod;
+  // decodificação de instrução que não pode ir para o cache
+  instr_decod_t decod_temp;
+  // cache de blocos básicos
+  bloco_t *blocos;
+  // se uma interrupção foi aceita (para cpu_executa_n parar)
+  bool interrompida;
+  // contexto salvo na última interrupção, e se ele é mantido também na
+  //   memória
+  cpu_contexto_t contexto;
+  bool contexto_na_memoria;
 };
 
 // CRIAÇÃO {{{1
@@ -52,6 +122,8 @@ cpu_t *cpu_cria(mmu_t *mmu, es_t *es)
   self->complemento = 0;
   self->modo = usuario;
   self->funcaoC = NULL;
+  self->interrompida = false;
+  self->contexto_na_memoria = true;
   // inicializa instruções privilegiadas
   memset(self->privilegiadas, 0, sizeof(self->privilegiadas));
   self->privilegiadas[PARA] = true;
@@ -59,6 +131,11 @@ cpu_t *cpu_cria(mmu_t *mmu, es_t *es)
   self->privilegiadas[ESCR] = true;
   self->privilegiadas[RETI] = true;
   self->privilegiadas[CHAMAC] = true;
+  // inicializa o cache de instruções decodificadas, todas inválidas
+  self->decod = calloc(mmu_tam_memoria(mmu), sizeof(*self->decod));
+  assert(self->decod != NULL);
+  self->blocos = calloc(N_BLOCOS, sizeof(*self->blocos));
+  assert(self->blocos != NULL);
   // gera uma interrupção de reset, para o SO poder executar
   cpu_interrompe(self, IRQ_RESET);
 
@@ -68,6 +145,8 @@ cpu_t *cpu_cria(mmu_t *mmu, es_t *es)
 void cpu_destroi(cpu_t *self)
 {
   // eu nao criei MMU nem es; quem criou que destrua!
+  free(self->decod);
+  free(self->blocos);
   free(self);
 }
 
@@ -77,6 +156,11 @@ void cpu_define_chamaC(cpu_t *self, func_chamaC_t funcaoC, void *argC)
   self->argC = argC;
 }
 
+bool cpu_parada(cpu_t *self)
+{
+  return self->erro == ERR_CPU_PARADA;
+}
+
 // IMPRESSÃO {{{1
 static void imprime_registradores(cpu_t *self, char *str)
 {
@@ -87,8 +171,10 @@ static void imprime_registradores(cpu_t *self, char *str)
 
 static void imprime_instrucao(cpu_t *self, char *str)
 {
+  // a descrição não pode interferir na execução: espia a memória, sem
+  //   marcar o acesso à página
   int opcode;
-  if (mmu_le(self->mmu, self->PC, &opcode, self->modo) != ERR_OK) {
+  if (mmu_espia(self->mmu, self->PC, &opcode, self->modo) != ERR_OK) {
     strcpy(str, " PC inválido");
     return;
   }
@@ -97,7 +183,7 @@ static void imprime_instrucao(cpu_t *self, char *str)
     // imprime argumento da instrução, se houver
   } else {
     int A1;
-    mmu_le(self->mmu, self->PC + 1, &A1, self->modo);
+    mmu_espia(self->mmu, self->PC + 1, &A1, self->modo);
     sprintf(str, " %02d %s %d", opcode, instrucao_nome(opcode), A1);
   }
 }
@@ -141,20 +227,6 @@ static bool pega_mem(cpu_t *self, int endereco, int *pval)
   return false;
 }
 
-// lê o opcode da instrução no PC
-// retorna true se ele pode ser executado, ou põe em erro o motivo de não poder
-static bool pega_opcode(cpu_t *self, int *popc)
-{
-  // não tem que testar endereços, é tarefa da mmu
-  // não pode executar se houver erro na leitura da memória
-  if (!pega_mem(self, self->PC, popc)) return false;
-  // pode executar se tiver privilégio para isso
-  if (self->modo == supervisor || !self->privilegiadas[*popc]) return true;
-  // não pode executar instrução privilegiada em modo usuário
-  self->erro = ERR_INSTR_PRIV;
-  return false;
-}
-
 // lê o argumento 1 da instrução no PC
 static bool pega_A1(cpu_t *self, int *pA1)
 {
@@ -192,62 +264,60 @@ static bool poe_es(cpu_t *self, int dispositivo, int val)
 // ---------------------------------------------------------------------
 // funções auxiliares para implementação de cada instrução
 
-static void op_NOP(cpu_t *self) // não faz nada
+// todas as funções recebem o argumento da instrução (A1) já lido da memória
+//   (instruções sem argumento ignoram A1)
+
+static void op_NOP(cpu_t *self, int A1) // não faz nada
 {
   self->PC += 1;
 }
 
-static void op_PARA(cpu_t *self) // para a CPU
+static void op_PARA(cpu_t *self, int A1) // para a CPU
 {
   self->erro = ERR_CPU_PARADA;
 }
 
-static void op_CARGI(cpu_t *self) // carrega imediato
+static void op_CARGI(cpu_t *self, int A1) // carrega imediato
 {
-  int A1;
-  if (pega_A1(self, &A1)) {
-    self->A = A1;
-    self->PC += 2;
-  }
+  self->A = A1;
+  self->PC += 2;
 }
 
-static void op_CARGM(cpu_t *self) // carrega da memória
+static void op_CARGM(cpu_t *self, int A1) // carrega da memória
 {
-  int A1, mA1;
-  if (pega_A1(self, &A1) && pega_mem(self, A1, &mA1)) {
+  int mA1;
+  if (pega_mem(self, A1, &mA1)) {
     self->A = mA1;
     self->PC += 2;
   }
 }
 
-static void op_CARGX(cpu_t *self) // carrega indexado
+static void op_CARGX(cpu_t *self, int A1) // carrega indexado
 {
-  int A1, mA1mX;
+  int mA1mX;
   int X = self->X;
-  if (pega_A1(self, &A1) && pega_mem(self, A1 + X, &mA1mX)) {
+  if (pega_mem(self, A1 + X, &mA1mX)) {
     self->A = mA1mX;
     self->PC += 2;
   }
 }
 
-static void op_ARMM(cpu_t *self) // armazena na memória
+static void op_ARMM(cpu_t *self, int A1) // armazena na memória
 {
-  int A1;
-  if (pega_A1(self, &A1) && poe_mem(self, A1, self->A)) {
+  if (poe_mem(self, A1, self->A)) {
     self->PC += 2;
   }
 }
 
-static void op_ARMX(cpu_t *self) // armazena indexado
+static void op_ARMX(cpu_t *self, int A1) // armazena indexado
 {
-  int A1;
   int X = self->X;
-  if (pega_A1(self, &A1) && poe_mem(self, A1 + X, self->A)) {
+  if (poe_mem(self, A1 + X, self->A)) {
     self->PC += 2;
   }
 }
 
-static void op_TRAX(cpu_t *self) // troca A com X
+static void op_TRAX(cpu_t *self, int A1) // troca A com X
 {
   int A = self->A;
   int X = self->X;
@@ -256,142 +326,137 @@ static void op_TRAX(cpu_t *self) // troca A com X
   self->PC += 1;
 }
 
-static void op_CPXA(cpu_t *self) // copia X para A
+static void op_CPXA(cpu_t *self, int A1) // copia X para A
 {
   self->A = self->X;
   self->PC += 1;
 }
 
-static void op_INCX(cpu_t *self) // incrementa X
+static void op_INCX(cpu_t *self, int A1) // incrementa X
 {
   self->X += 1;
   self->PC += 1;
 }
 
-static void op_SOMA(cpu_t *self) // soma
+static void op_SOMA(cpu_t *self, int A1) // soma
 {
-  int A1, mA1;
-  if (pega_A1(self, &A1) && pega_mem(self, A1, &mA1)) {
+  int mA1;
+  if (pega_mem(self, A1, &mA1)) {
     self->A += mA1;
     self->PC += 2;
   }
 }
 
-static void op_SUB(cpu_t *self) // subtração
+static void op_SUB(cpu_t *self, int A1) // subtração
 {
-  int A1, mA1;
-  if (pega_A1(self, &A1) && pega_mem(self, A1, &mA1)) {
+  int mA1;
+  if (pega_mem(self, A1, &mA1)) {
     self->A -= mA1;
     self->PC += 2;
   }
 }
 
-static void op_MULT(cpu_t *self) // multiplicação
+static void op_MULT(cpu_t *self, int A1) // multiplicação
 {
-  int A1, mA1;
-  if (pega_A1(self, &A1) && pega_mem(self, A1, &mA1)) {
+  int mA1;
+  if (pega_mem(self, A1, &mA1)) {
     self->A *= mA1;
     self->PC += 2;
   }
 }
 
-static void op_DIV(cpu_t *self) // divisão
+static void op_DIV(cpu_t *self, int A1) // divisão
 {
-  int A1, mA1;
-  if (pega_A1(self, &A1) && pega_mem(self, A1, &mA1)) {
+  int mA1;
+  if (pega_mem(self, A1, &mA1)) {
     self->A /= mA1;
     self->PC += 2;
   }
 }
 
-static void op_RESTO(cpu_t *self) // resto
+static void op_RESTO(cpu_t *self, int A1) // resto
 {
-  int A1, mA1;
-  if (pega_A1(self, &A1) && pega_mem(self, A1, &mA1)) {
+  int mA1;
+  if (pega_mem(self, A1, &mA1)) {
     self->A %= mA1;
     self->PC += 2;
   }
 }
 
-static void op_NEG(cpu_t *self) // inverte sinal
+static void op_NEG(cpu_t *self, int A1) // inverte sinal
 {
   self->A = -self->A;
   self->PC += 1;
 }
 
-static void op_DESV(cpu_t *self) // desvio incondicional
+static void op_DESV(cpu_t *self, int A1) // desvio incondicional
 {
-  int A1;
-  if (pega_A1(self, &A1)) {
-    self->PC = A1;
-  }
+  self->PC = A1;
 }
 
-static void op_DESVZ(cpu_t *self) // desvio condicional
+static void op_DESVZ(cpu_t *self, int A1) // desvio condicional
 {
   if (self->A == 0) {
-    op_DESV(self);
+    op_DESV(self, A1);
   } else {
     self->PC += 2;
   }
 }
 
-static void op_DESVNZ(cpu_t *self) // desvio condicional
+static void op_DESVNZ(cpu_t *self, int A1) // desvio condicional
 {
   if (self->A != 0) {
-    op_DESV(self);
+    op_DESV(self, A1);
   } else {
     self->PC += 2;
   }
 }
 
-static void op_DESVN(cpu_t *self) // desvio condicional
+static void op_DESVN(cpu_t *self, int A1) // desvio condicional
 {
   if (self->A < 0) {
-    op_DESV(self);
+    op_DESV(self, A1);
   } else {
     self->PC += 2;
   }
 }
 
-static void op_DESVP(cpu_t *self) // desvio condicional
+static void op_DESVP(cpu_t *self, int A1) // desvio condicional
 {
   if (self->A > 0) {
-    op_DESV(self);
+    op_DESV(self, A1);
   } else {
     self->PC += 2;
   }
 }
 
-static void op_CHAMA(cpu_t *self) // chamada de subrotina
+static void op_CHAMA(cpu_t *self, int A1) // chamada de subrotina
 {
-  int A1;
-  if (pega_A1(self, &A1) && poe_mem(self, A1, self->PC + 2)) {
+  if (poe_mem(self, A1, self->PC + 2)) {
     self->PC = A1 + 1;
   }
 }
 
-static void op_RET(cpu_t *self) // retorno de subrotina
+static void op_RET(cpu_t *self, int A1) // retorno de subrotina
 {
-  int A1, mA1;
-  if (pega_A1(self, &A1) && pega_mem(self, A1, &mA1)) {
+  int mA1;
+  if (pega_mem(self, A1, &mA1)) {
     self->PC = mA1;
   }
 }
 
-static void op_LE(cpu_t *self) // leitura de E/S
+static void op_LE(cpu_t *self, int A1) // leitura de E/S
 {
-  int A1, dado;
-  if (pega_A1(self, &A1) && pega_es(self, A1, &dado)) {
+  int dado;
+  if (pega_es(self, A1, &dado)) {
     self->A = dado;
     self->PC += 2;
   }
 }
 
-static void op_ESCR(cpu_t *self) // escrita de E/S
+static void op_ESCR(cpu_t *self, int A1) // escrita de E/S
 {
-  int A1;
-  if (pega_A1(self, &A1) && poe_es(self, A1, self->A)) {
+  if (poe_es(self, A1, self->A)) {
     self->PC += 2;
   }
 }
@@ -399,12 +464,12 @@ static void op_ESCR(cpu_t *self) // escrita de E/S
 // declara uma função auxiliar (só para a interrupção e o retorno ficarem perto)
 static void cpu_desinterrompe(cpu_t *self);
 
-static void op_RETI(cpu_t *self) // retorno de interrupção
+static void op_RETI(cpu_t *self, int A1) // retorno de interrupção
 {
   cpu_desinterrompe(self);
 }
 
-static void op_CHAMAC(cpu_t *self) // chama função em C
+static void op_CHAMAC(cpu_t *self, int A1) // chama função em C
 {
   if (self->funcaoC == NULL) {
     self->erro = ERR_OP_INV;
@@ -414,7 +479,7 @@ static void op_CHAMAC(cpu_t *self) // chama função em C
   self->PC += 1;
 }
 
-static void op_CHAMAS(cpu_t *self) // chamada de sistema
+static void op_CHAMAS(cpu_t *self, int A1) // chamada de sistema
 {
   self->PC += 1;
   // causa uma interrupção, para forçar a execução do SO
@@ -422,96 +487,498 @@ static void op_CHAMAS(cpu_t *self) // chamada de sistema
 
 }
 
+static void op_INV(cpu_t *self, int A1) // opcode que não é de instrução
+{
+  self->erro = ERR_INSTR_INV;
+}
+
+// DECODIFICAÇÃO {{{1
+
+// tabela com a função que implementa cada opcode
+// opcodes sem função (pseudo-instruções) são inválidos
+static operacao_t operacoes[N_OPCODE] = {
+  [NOP]    = op_NOP,
+  [PARA]   = op_PARA,
+  [CARGI]  = op_CARGI,
+  [CARGM]  = op_CARGM,
+  [CARGX]  = op_CARGX,
+  [ARMM]   = op_ARMM,
+  [ARMX]   = op_ARMX,
+  [TRAX]   = op_TRAX,
+  [CPXA]   = op_CPXA,
+  [INCX]   = op_INCX,
+  [SOMA]   = op_SOMA,
+  [SUB]    = op_SUB,
+  [MULT]   = op_MULT,
+  [DIV]    = op_DIV,
+  [RESTO]  = op_RESTO,
+  [NEG]    = op_NEG,
+  [DESV]   = op_DESV,
+  [DESVZ]  = op_DESVZ,
+  [DESVNZ] = op_DESVNZ,
+  [DESVN]  = op_DESVN,
+  [DESVP]  = op_DESVP,
+  [CHAMA]  = op_CHAMA,
+  [RET]    = op_RET,
+  [LE]     = op_LE,
+  [ESCR]   = op_ESCR,
+  [RETI]   = op_RETI,
+  [CHAMAC] = op_CHAMAC,
+  [CHAMAS] = op_CHAMAS,
+};
+
+// preenche 'instr' com a decodificação do opcode 'opcode' (exceto A1)
+static void decodifica_opcode(cpu_t *self, int opcode, instr_decod_t *instr)
+{
+  instr->opcode = opcode;
+  if (opcode < 0 || opcode >= N_OPCODE || operacoes[opcode] == NULL) {
+    instr->op = op_INV;
+    instr->privilegiada = false;
+    instr->acessa_es = false;
+    instr->n_args = 0;
+    return;
+  }
+  instr->op = operacoes[opcode];
+  instr->privilegiada = self->privilegiadas[opcode];
+  instr->acessa_es = opcode == LE || opcode == ESCR || opcode == CHAMAC;
+  instr->n_args = instrucao_num_args(opcode);
+}
+
+// obtém a instrução no endereço físico 'endfis', decodificada
+// usa o cache se a decodificação ainda for válida; senão decodifica e guarda
+//   no cache, a menos que a instrução atravesse o limite do quadro (nesse caso
+//   o argumento está em outra página, e não dá para guardar com o quadro)
+// se o argumento estiver fora da memória, a instrução é tratada como se
+//   atravessasse o limite do quadro (o erro é detectado na execução)
+// retorna NULL se não for possível ler a instrução (não altera o estado da CPU)
+static instr_decod_t *pega_instrucao_decodificada(cpu_t *self, int endfis)
+{
+  if (endfis < 0 || endfis >= mmu_tam_memoria(self->mmu)) return NULL;
+  int quadro = endfis / TAM_PAGINA;
+  unsigned versao = mmu_versao_quadro(self->mmu, quadro);
+  instr_decod_t *instr = &self->decod[endfis];
+  if (instr->versao == versao) return instr;
+
+  int opcode;
+  if (mmu_le(self->mmu, endfis, &opcode, supervisor) != ERR_OK) return NULL;
+  bool atravessa = instrucao_num_args(opcode) > 0
+                   && ((endfis + 1) / TAM_PAGINA != quadro
+                       || endfis + 1 >= mmu_tam_memoria(self->mmu));
+  if (atravessa) instr = &self->decod_temp;
+  decodifica_opcode(self, opcode, instr);
+  if (instr->n_args > 0) {
+    if (atravessa) {
+      // o argumento é lido quando a instrução for executada
+      return instr;
+    }
+    if (mmu_le(self->mmu, endfis + 1, &instr->A1, supervisor) != ERR_OK) {
+      return NULL;
+    }
+    mmu_marca_codigo(self->mmu, endfis + 1);
+  }
+  mmu_marca_codigo(self->mmu, endfis);
+  instr->versao = versao;
+  return instr;
+}
+
+// BLOCOS BÁSICOS {{{1
+
+// passo de uma instrução só
+static int passo_1(cpu_t *self, passo_t *passo)
+{
+  passo->op[0](self, passo->A1[0]);
+  return 1;
+}
+
+// passo de várias instruções, sem implementação própria
+static int passo_n(cpu_t *self, passo_t *passo)
+{
+  for (int i = 0; i < passo->n_instr; i++) {
+    passo->op[i](self, passo->A1[i]);
+    if (self->erro != ERR_OK) return i + 1;
+  }
+  return passo->n_instr;
+}
+
+// superinstruções
+// cada uma faz o mesmo que as instruções que a compõem, em sequência, e para
+//   na que causar erro
+
+static int passo_CARGM_SOMA_ARMM(cpu_t *self, passo_t *passo)
+{
+  int m;
+  if (!pega_mem(self, passo->A1[0], &m)) return 1;
+  self->A = m;
+  self->PC += 2;
+  if (!pega_mem(self, passo->A1[1], &m)) return 2;
+  self->A += m;
+  self->PC += 2;
+  if (poe_mem(self, passo->A1[2], self->A)) {
+    self->PC += 2;
+  }
+  return 3;
+}
+
+static int passo_TRAX_ARMM(cpu_t *self, passo_t *passo)
+{
+  int A = self->A;
+  self->A = self->X;
+  self->X = A;
+  self->PC += 1;
+  if (poe_mem(self, passo->A1[1], self->A)) {
+    self->PC += 2;
+  }
+  return 2;
+}
+
+static int passo_CPXA_RESTO_DESVNZ(cpu_t *self, passo_t *passo)
+{
+  self->A = self->X;
+  self->PC += 1;
+  int m;
+  if (!pega_mem(self, passo->A1[1], &m)) return 2;
+  self->A %= m;
+  self->PC += 2;
+  if (self->A != 0) {
+    self->PC = passo->A1[2];
+  } else {
+    self->PC += 2;
+  }
+  return 3;
+}
+
+static int passo_CPXA_SUB_DESVNZ(cpu_t *self, passo_t *passo)
+{
+  self->A = self->X;
+  self->PC += 1;
+  int m;
+  if (!pega_mem(self, passo->A1[1], &m)) return 2;
+  self->A -= m;
+  self->PC += 2;
+  if (self->A != 0) {
+    self->PC = passo->A1[2];
+  } else {
+    self->PC += 2;
+  }
+  return 3;
+}
+
+static struct {
+  int n_instr;
+  int opcode[MAX_FUSAO];
+  f_passo_t executa;
+} superinstrucoes[] = {
+  { 3, { CARGM, SOMA, ARMM },   passo_CARGM_SOMA_ARMM },
+  { 2, { TRAX, ARMM },          passo_TRAX_ARMM },
+  { 3, { CPXA, RESTO, DESVNZ }, passo_CPXA_RESTO_DESVNZ },
+  { 3, { CPXA, SUB, DESVNZ },   passo_CPXA_SUB_DESVNZ },
+};
+#define N_SUPERINSTRUCOES (sizeof(superinstrucoes) / sizeof(superinstrucoes[0]))
+
+// se a instrução pode fazer parte de um bloco
+static bool vai_para_bloco(cpu_t *self, instr_decod_t *instr)
+{
+  return instr != NULL && instr != &self->decod_temp && instr->op != op_INV
+         && !instr->privilegiada && !instr->acessa_es
+         && instr->opcode != CHAMAS;
+}
+
+// se a instrução termina o bloco (depois de ser executada, a próxima pode não
+//   ser a seguinte na memória)
+static bool termina_bloco(int opcode)
+{
+  return opcode == DESV || opcode == DESVZ || opcode == DESVNZ
+         || opcode == DESVN || opcode == DESVP || opcode == CHAMA
+         || opcode == RET;
+}
+
+static bool escreve_na_memoria(int opcode)
+{
+  return opcode == ARMM || opcode == ARMX || opcode == CHAMA;
+}
+
+// preenche 'passo' com as 'n' instruções decodificadas em 'instrs'
+static void monta_passo(passo_t *passo, instr_decod_t **instrs, int n)
+{
+  passo->n_instr = n;
+  for (int i = 0; i < n; i++) {
+    passo->op[i] = instrs[i]->op;
+    passo->A1[i] = instrs[i]->A1;
+  }
+  passo->escreve = escreve_na_memoria(instrs[n - 1]->opcode);
+  passo->executa = n == 1 ? passo_1 : passo_n;
+  for (int s = 0; s < N_SUPERINSTRUCOES; s++) {
+    if (superinstrucoes[s].n_instr != n) continue;
+    int i;
+    for (i = 0; i < n; i++) {
+      if (superinstrucoes[s].opcode[i] != instrs[i]->opcode) break;
+    }
+    if (i == n) {
+      passo->executa = superinstrucoes[s].executa;
+      break;
+    }
+  }
+}
+
+// monta no bloco 'bloco' o bloco básico que inicia no endereço físico 'endfis'
+static void monta_bloco(cpu_t *self, bloco_t *bloco, int endfis)
+{
+  int quadro = endfis / TAM_PAGINA;
+  bloco->endfis = endfis;
+  bloco->versao = mmu_versao_quadro(self->mmu, quadro);
+  bloco->n_passos = 0;
+
+  // decodifica as instruções do bloco; para no fim do quadro ou da memória,
+  //   ou em uma instrução que não pode ser lida
+  instr_decod_t *instrs[TAM_PAGINA];
+  int n = 0;
+  int end = endfis;
+  int tam_mem = mmu_tam_memoria(self->mmu);
+  while (end / TAM_PAGINA == quadro && end < tam_mem) {
+    instr_decod_t *instr = pega_instrucao_decodificada(self, end);
+    if (!vai_para_bloco(self, instr)) break;
+    instrs[n++] = instr;
+    if (termina_bloco(instr->opcode)) break;
+    end += 1 + instr->n_args;
+  }
+
+  // agrupa as instruções em passos; uma instrução que escreve na memória
+  //   termina o passo, e os passos de uma sequência sem escritas são formados
+  //   do fim para o início, para que o desvio no final do bloco fique junto
+  //   com as instruções que calculam a condição
+  int inicio = 0;
+  while (inicio < n) {
+    int fim = inicio;
+    while (fim < n - 1 && !escreve_na_memoria(instrs[fim]->opcode)) fim++;
+    int tam = fim - inicio + 1;
+    int primeiro = tam % MAX_FUSAO;
+    if (primeiro == 0) primeiro = MAX_FUSAO;
+    for (int i = inicio; i <= fim; ) {
+      int n_passo = i == inicio ? primeiro : MAX_FUSAO;
+      monta_passo(&bloco->passos[bloco->n_passos++], &instrs[i], n_passo);
+      i += n_passo;
+    }
+    inicio = fim + 1;
+  }
+}
+
+// retorna o bloco básico que inicia no endereço físico 'endfis', montando-o
+//   se não estiver no cache
+static bloco_t *pega_bloco(cpu_t *self, int endfis)
+{
+  bloco_t *bloco = &self->blocos[endfis % N_BLOCOS];
+  unsigned versao = mmu_versao_quadro(self->mmu, endfis / TAM_PAGINA);
+  if (bloco->endfis != endfis || bloco->versao != versao) {
+    monta_bloco(self, bloco, endfis);
+  }
+  return bloco;
+}
+
+// executa os passos do bloco 'bloco', que inicia no PC, sem passar de 'max'
+//   instruções
+// para se uma instrução causar erro, ou se uma escrita alterar o quadro do
+//   bloco (o resto do bloco pode ter mudado)
+// retorna o número de instruções executadas
+static int executa_bloco(cpu_t *self, bloco_t *bloco, int max)
+{
+  int quadro = bloco->endfis / TAM_PAGINA;
+  int executadas = 0;
+  for (int p = 0; p < bloco->n_passos; p++) {
+    passo_t *passo = &bloco->passos[p];
+    if (executadas + passo->n_instr > max) break;
+    executadas += passo->executa(self, passo);
+    if (self->erro != ERR_OK) break;
+    if (passo->escreve
+        && mmu_versao_quadro(self->mmu, quadro) != bloco->versao) break;
+  }
+  return executadas;
+}
+
 // EXECUTA UMA INSTRUÇÃO {{{1
 
-static void executa_a_instrucao(cpu_t *self, int opcode)
-{
-  switch (opcode) {
-    case NOP:    op_NOP(self);    break;
-    case PARA:   op_PARA(self);   break;
-    case CARGI:  op_CARGI(self);  break;
-    case CARGM:  op_CARGM(self);  break;
-    case CARGX:  op_CARGX(self);  break;
-    case ARMM:   op_ARMM(self);   break;
-    case ARMX:   op_ARMX(self);   break;
-    case TRAX:   op_TRAX(self);   break;
-    case CPXA:   op_CPXA(self);   break;
-    case INCX:   op_INCX(self);   break;
-    case SOMA:   op_SOMA(self);   break;
-    case SUB:    op_SUB(self);    break;
-    case MULT:   op_MULT(self);   break;
-    case DIV:    op_DIV(self);    break;
-    case RESTO:  op_RESTO(self);  break;
-    case NEG:    op_NEG(self);    break;
-    case DESV:   op_DESV(self);   break;
-    case DESVZ:  op_DESVZ(self);  break;
-    case DESVNZ: op_DESVNZ(self); break;
-    case DESVN:  op_DESVN(self);  break;
-    case DESVP:  op_DESVP(self);  break;
-    case CHAMA:  op_CHAMA(self);  break;
-    case RET:    op_RET(self);    break;
-    case LE:     op_LE(self);     break;
-    case ESCR:   op_ESCR(self);   break;
-    case RETI:   op_RETI(self);   break;
-    case CHAMAC: op_CHAMAC(self); break;
-    case CHAMAS: op_CHAMAS(self); break;
-    default:     self->erro = ERR_INSTR_INV;
+// traduz o endereço do PC, colocando o endereço físico em '*pendfis'
+// retorna false (e altera o erro da CPU) se não for possível
+static bool traduz_PC(cpu_t *self, int *pendfis)
+{
+  // não tem que testar endereços, é tarefa da mmu
+  self->erro = mmu_traduz(self->mmu, self->PC, pendfis, self->modo);
+  if (self->erro != ERR_OK) {
+    self->complemento = self->PC;
+    return false;
   }
+  return true;
 }
 
-void cpu_executa_1(cpu_t *self)
+// a instrução no PC, decodificada, sendo 'endfis' o endereço físico do PC
+// retorna NULL (e altera o erro da CPU) se não for possível lê-la
+static instr_decod_t *instrucao_no_PC(cpu_t *self, int endfis)
 {
-  // não executa se CPU já estiver em erro
-  if (self->erro != ERR_OK) return;
+  instr_decod_t *instr = pega_instrucao_decodificada(self, endfis);
+  if (instr == NULL) {
+    self->erro = ERR_END_INV;
+    self->complemento = self->PC;
+  }
+  return instr;
+}
 
-  int opcode;
-  if (pega_opcode(self, &opcode)) {
-    executa_a_instrucao(self, opcode);
+// busca a instrução no PC, decodificada
+// retorna NULL (e altera o erro da CPU) se não for possível
+static instr_decod_t *busca_instrucao(cpu_t *self)
+{
+  int endfis;
+  if (!traduz_PC(self, &endfis)) return NULL;
+  return instrucao_no_PC(self, endfis);
+}
+
+// executa a instrução decodificada 'instr', que está no PC
+static void executa_instrucao(cpu_t *self, instr_decod_t *instr)
+{
+  // não pode executar instrução privilegiada em modo usuário
+  if (self->modo != supervisor && instr->privilegiada) {
+    self->erro = ERR_INSTR_PRIV;
+  } else if (instr == &self->decod_temp && instr->n_args > 0) {
+    // instrução que atravessa o limite do quadro, lê o argumento agora
+    int A1;
+    if (pega_A1(self, &A1)) {
+      instr->op(self, A1);
+    }
+  } else {
+    instr->op(self, instr->A1);
   }
+}
 
-  // se a CPU entrou em erro, causa uma interrupção
-  // a menos que a CPU tenha parado, porque a única forma de a CPU entrar nesse
-  //   estado é pela execução da instrução PARA em modo supervisor, e é a forma de
-  //   o SO dizer que não tem mais nada para fazer, e deve-se deixar a CPU dormindo
-  //   até que venha uma interrupção de E/S
+// se a CPU entrou em erro, causa uma interrupção
+// a menos que a CPU tenha parado, porque a única forma de a CPU entrar nesse
+//   estado é pela execução da instrução PARA em modo supervisor, e é a forma de
+//   o SO dizer que não tem mais nada para fazer, e deve-se deixar a CPU dormindo
+//   até que venha uma interrupção de E/S
+static void verifica_erro(cpu_t *self)
+{
   if (self->erro != ERR_OK && self->erro != ERR_CPU_PARADA) {
     // se a interrupção não é aceita nesse ponto, temos um problema grave...
     assert(cpu_interrompe(self, IRQ_ERR_CPU));
   }
 }
 
+void cpu_executa_1(cpu_t *self)
+{
+  // não executa se CPU já estiver em erro
+  if (self->erro != ERR_OK) return;
+
+  instr_decod_t *instr = busca_instrucao(self);
+  if (instr != NULL) {
+    executa_instrucao(self, instr);
+  }
+
+  verifica_erro(self);
+}
+
+int cpu_executa_n(cpu_t *self, int n)
+{
+  int executadas = 0;
+  self->interrompida = false;
+  while (executadas < n && self->erro == ERR_OK) {
+    int endfis;
+    instr_decod_t *instr = NULL;
+    if (traduz_PC(self, &endfis)) {
+      // executa o bloco básico que inicia no PC, se existir e couber pelo
+      //   menos o primeiro passo; senão, executa uma instrução só
+      bloco_t *bloco = pega_bloco(self, endfis);
+      if (bloco->n_passos > 0 && bloco->passos[0].n_instr <= n - executadas) {
+        executadas += executa_bloco(self, bloco, n - executadas);
+        verifica_erro(self);
+        if (self->interrompida) break;
+        continue;
+      }
+      instr = instrucao_no_PC(self, endfis);
+    }
+    if (instr != NULL) {
+      // a instrução vai acessar um dispositivo, que deve ver o tempo atualizado
+      //   com as instruções já executadas; deixa ela para o próximo bloco
+      if (instr->acessa_es && executadas > 0) break;
+      executa_instrucao(self, instr);
+    }
+    executadas++;
+    verifica_erro(self);
+    if (self->interrompida) break;
+  }
+  return executadas;
+}
+
 // INTERRUPÇÃO {{{1
 
+// coloca o contexto no início da memória; os endereços são físicos
+static void contexto_para_memoria(cpu_t *self)
+{
+  cpu_contexto_t *ctx = &self->contexto;
+  mmu_escreve(self->mmu, IRQ_END_PC,          ctx->PC,          supervisor);
+  mmu_escreve(self->mmu, IRQ_END_A,           ctx->A,           supervisor);
+  mmu_escreve(self->mmu, IRQ_END_X,           ctx->X,           supervisor);
+  mmu_escreve(self->mmu, IRQ_END_erro,        ctx->erro,        supervisor);
+  mmu_escreve(self->mmu, IRQ_END_complemento, ctx->complemento, supervisor);
+  mmu_escreve(self->mmu, IRQ_END_modo,        ctx->modo,        supervisor);
+}
+
+// pega o contexto do início da memória, que pode ter sido alterado pelo
+//   tratador de interrupção
+static void contexto_da_memoria(cpu_t *self)
+{
+  cpu_contexto_t *ctx = &self->contexto;
+  mmu_le(self->mmu, IRQ_END_PC,          &ctx->PC,          supervisor);
+  mmu_le(self->mmu, IRQ_END_A,           &ctx->A,           supervisor);
+  mmu_le(self->mmu, IRQ_END_X,           &ctx->X,           supervisor);
+  mmu_le(self->mmu, IRQ_END_erro,        &ctx->erro,        supervisor);
+  mmu_le(self->mmu, IRQ_END_complemento, &ctx->complemento, supervisor);
+  mmu_le(self->mmu, IRQ_END_modo,        &ctx->modo,        supervisor);
+}
+
+void cpu_salva_contexto(cpu_t *self, cpu_contexto_t *pctx)
+{
+  if (self->contexto_na_memoria) contexto_da_memoria(self);
+  *pctx = self->contexto;
+}
+
+void cpu_carrega_contexto(cpu_t *self, cpu_contexto_t *pctx)
+{
+  self->contexto = *pctx;
+  if (self->contexto_na_memoria) contexto_para_memoria(self);
+}
+
+void cpu_define_contexto_na_memoria(cpu_t *self, bool na_memoria)
+{
+  self->contexto_na_memoria = na_memoria;
+}
+
 bool cpu_interrompe(cpu_t *self, irq_t irq)
 {
   // só aceita interrupção em modo usuário ou quando a CPU está dormindo
   if (self->modo != usuario && self->erro != ERR_CPU_PARADA) return false;
 
-  // A interrupção será atendida em modo supervisor. Já troca o modo aqui
-  //   para garantir que o estado do processador será salvo em endereços
-  //   físicos e não lógicos, e que se tem permissão para realizar esse
-  //   acesso (para quando existir proteção de memória)
+  // A interrupção será atendida em modo supervisor
   self->modo = supervisor;
 
-  // esta é uma CPU boazinha, salva todo o estado interno da CPU no início da memória
-  // self->erro é alterado por poe_mem, copia antes!
-  int erro = self->erro;
-  int complemento = self->complemento;
-  poe_mem(self, IRQ_END_PC,          self->PC);
-  poe_mem(self, IRQ_END_A,           self->A);
-  poe_mem(self, IRQ_END_X,           self->X);
-  poe_mem(self, IRQ_END_erro,        erro);
-  poe_mem(self, IRQ_END_complemento, complemento);
-  poe_mem(self, IRQ_END_modo,        usuario);
+  // esta é uma CPU boazinha, salva todo o estado interno da CPU no banco de
+  //   registradores (e no início da memória, se for o caso)
+  self->contexto = (cpu_contexto_t){
+    .PC          = self->PC,
+    .A           = self->A,
+    .X           = self->X,
+    .erro        = self->erro,
+    .complemento = self->complemento,
+    .modo        = usuario,
+  };
+  if (self->contexto_na_memoria) contexto_para_memoria(self);
 
   // altera o estado da CPU para ela poder executar o tratador de interrupção
   // vai iniciar o tratamento da interrupção no endereço IRQ_END_TRATADOR,
   //   com o A contendo o valor da requisição de interrupção e sem erro
   // se o tratador da interrupção precisar do estado da CPU de antes da
-  //   interrupção, deve acessar o início da memória, onde esse estado foi salvo
+  //   interrupção, deve usar cpu_salva_contexto (ou acessar o início da
+  //   memória, se o contexto estiver lá)
   self->PC = IRQ_END_TRATADOR;
   self->A = irq;
   self->erro = ERR_OK;
+  self->interrompida = true;
 
   return true;
 }
@@ -522,19 +989,14 @@ static void cpu_desinterrompe(cpu_t *self)
   // recupera o estado da CPU, para que volte a executar o que foi interrompido
   //   quando a interrupção foi atendida
   
-  // tem que estar em modo supervisor para ler nesses endereços
-  self->modo = supervisor;
-  pega_mem(self, IRQ_END_PC,          &self->PC);
-  pega_mem(self, IRQ_END_A,           &self->A);
-  pega_mem(self, IRQ_END_X,           &self->X);
-  // não dá para pegar o erro nem o modo diretamente porque eles não são int
-  int erro, modo;
-  pega_mem(self, IRQ_END_erro,        &erro);
-  pega_mem(self, IRQ_END_complemento, &self->complemento);
-  pega_mem(self, IRQ_END_modo,        &modo);
-  self->modo = modo;
-  // coloca o erro por último, porque pode ser alterado por pega_mem
-  self->erro = erro;
+  if (self->contexto_na_memoria) contexto_da_memoria(self);
+  cpu_contexto_t *ctx = &self->contexto;
+  self->PC = ctx->PC;
+  self->A = ctx->A;
+  self->X = ctx->X;
+  self->erro = ctx->erro;
+  self->complemento = ctx->complemento;
+  self->modo = ctx->modo;
 }
 
 // vim: foldmethod=marker
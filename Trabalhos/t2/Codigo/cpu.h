@@ -19,6 +19,17 @@ typedef enum { supervisor, usuario } cpu_modo_t;
 // tipo da função a ser chamada quando executar a instrução CHAMAC
 typedef int (*func_chamaC_t)(void *argC, int reg_A);
 
+// contexto de execução: o estado da CPU que é salvo quando ela aceita uma
+//   interrupção, e recuperado quando retorna dela (instrução RETI)
+typedef struct {
+  int PC;
+  int A;
+  int X;
+  int erro;
+  int complemento;
+  int modo;
+} cpu_contexto_t;
+
 
 // cria uma unidade de execução com acesso à MMU e ao
 //   controlador de E/S fornecidos
@@ -33,17 +44,43 @@ void cpu_destroi(cpu_t *self);
 //     e causa uma interrupção
 void cpu_executa_1(cpu_t *self);
 
+// executa até 'n' instruções, como cpu_executa_1, em um bloco
+// o bloco termina antes das 'n' instruções se:
+//   - a CPU parar ou aceitar uma interrupção (a instrução que causou a
+//     interrupção é contada como executada);
+//   - a próxima instrução acessar dispositivos de E/S (LE, ESCR, CHAMAC), a
+//     menos que seja a primeira do bloco -- quem controla a CPU deve atualizar
+//     o relógio e os dispositivos antes que ela seja executada
+// retorna o número de instruções executadas (0 se a CPU estiver em erro)
+int cpu_executa_n(cpu_t *self, int n);
+
 // implementa uma interrupção
-// passa para modo supervisor, salva o estado da CPU no início da memória,
-//   altera A para identificar a requisição de interrupção, altera PC para
-//   o endereço do tratador de interrupção
+// passa para modo supervisor, salva o contexto da CPU (ver
+//   cpu_salva_contexto), altera A para identificar a requisição de
+//   interrupção, altera PC para o endereço do tratador de interrupção
 // retorna true se interrupção foi aceita ou false caso contrário
 bool cpu_interrompe(cpu_t *self, irq_t irq);
 
+// o contexto salvo na interrupção fica em um banco de registradores da CPU;
+//   o tratador de interrupção pode consultá-lo e alterá-lo com as funções
+//   abaixo, e RETI continua a execução no contexto que estiver lá
+// coloca em '*pctx' o contexto salvo
+void cpu_salva_contexto(cpu_t *self, cpu_contexto_t *pctx);
+// altera o contexto a ser recuperado por RETI
+void cpu_carrega_contexto(cpu_t *self, cpu_contexto_t *pctx);
+// se 'na_memoria' for true (o padrão), o contexto é mantido também no início
+//   da memória (endereços IRQ_END_PC a IRQ_END_modo), para tratadores que
+//   acessam o contexto por lá: é colocado na memória na interrupção, e RETI e
+//   cpu_salva_contexto o pegam da memória; se for false, a memória não é usada
+void cpu_define_contexto_na_memoria(cpu_t *self, bool na_memoria);
+
 // define a função a chamar quando executar a instrução CHAMAC
 // e o argumento a passar para ela (normalmente, um ponteiro para o SO)
 void cpu_define_chamaC(cpu_t *self, func_chamaC_t func, void *argC);
 
+// retorna true se a CPU está parada (executou PARA), esperando uma interrupção
+bool cpu_parada(cpu_t *self);
+
 // concatena a descrição do estado da CPU no final de str
 void cpu_concatena_descricao(cpu_t *self, char *str);
 
@@ -27,8 +27,23 @@ typedef enum {
   D_RELOGIO_REAL          = 17,
   D_RELOGIO_TIMER         = 18,
   D_RELOGIO_INTERRUPCAO   = 19,
-  N_DISPOSITIVOS
+  D_TERM_INT_TECLADO      = 20,  // interrupções de teclado (mapa de bits)
+  D_TERM_INT_TELA         = 21,  // interrupções de tela (mapa de bits)
+  N_DISPOSITIVOS                 // número de dispositivos de número fixo
 } dispositivo_id_t;
 
+// número máximo de terminais (identificados pelas letras A a Z)
+#define MAX_TERMINAIS 26
+
+// número do dispositivo 'd' do terminal 't' (0 para o A), onde 'd' é um dos
+//   D_TERM_A_xxx; os terminais A a D usam os números acima, os seguintes usam
+//   4 números cada, a partir de N_DISPOSITIVOS, na mesma ordem
+#define D_TERMINAL(t, d) \
+  ((t) < 4 ? (t) * 4 + (d) : N_DISPOSITIVOS + ((t) - 4) * 4 + (d))
+
+// número total de dispositivos, com 'n' terminais
+#define N_DISPOSITIVOS_COM_TERMINAIS(n) \
+  (N_DISPOSITIVOS + ((n) > 4 ? ((n) - 4) * 4 : 0))
+
 #endif // DISPOSITIVOS_H
 
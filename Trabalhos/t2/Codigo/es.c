@@ -23,18 +23,40 @@ typedef struct {
 
 // define a estrutura opaca
 struct es_t {
-  dispositivo_t dispositivos[N_DISPOSITIVOS];
+  int n_dispositivos;
+  dispositivo_t *dispositivos;
 };
 
-es_t *es_cria(void)
+// operações colocadas no lugar das que o dispositivo não tem, para que
+//   es_le e es_escreve não precisem testar
+static err_t es_leitura_invalida(void *controladora, int id, int *pvalor)
 {
-  es_t *self = calloc(1, sizeof(*self)); // com calloc já zera toda a struct
+  return ERR_OP_INV;
+}
+
+static err_t es_escrita_invalida(void *controladora, int id, int valor)
+{
+  return ERR_OP_INV;
+}
+
+es_t *es_cria(int n_dispositivos)
+{
+  es_t *self = malloc(sizeof(*self));
   assert(self != NULL);
+  self->n_dispositivos = n_dispositivos;
+  // com calloc já zera todos os dispositivos
+  self->dispositivos = calloc(n_dispositivos, sizeof(*self->dispositivos));
+  assert(self->dispositivos != NULL);
+  for (int d = 0; d < n_dispositivos; d++) {
+    self->dispositivos[d].f_leitura = es_leitura_invalida;
+    self->dispositivos[d].f_escrita = es_escrita_invalida;
+  }
   return self;
 }
 
 void es_destroi(es_t *self)
 {
+  free(self->dispositivos);
   free(self);
 }
 
@@ -42,28 +64,40 @@ bool es_registra_dispositivo(es_t *self, dispositivo_id_t dispositivo,
                              void *controladora, int id,
                              f_leitura_t f_leitura, f_escrita_t f_escrita)
 {
-  if (dispositivo < 0 || dispositivo >= N_DISPOSITIVOS) return false;
-  self->dispositivos[dispositivo].controladora = controladora;
-  self->dispositivos[dispositivo].id = id;
-  self->dispositivos[dispositivo].f_leitura = f_leitura;
-  self->dispositivos[dispositivo].f_escrita = f_escrita;
+  if (dispositivo < 0 || dispositivo >= self->n_dispositivos) return false;
+  dispositivo_t *disp = &self->dispositivos[dispositivo];
+  disp->controladora = controladora;
+  disp->id = id;
+  disp->f_leitura = f_leitura != NULL ? f_leitura : es_leitura_invalida;
+  disp->f_escrita = f_escrita != NULL ? f_escrita : es_escrita_invalida;
+  return true;
+}
+
+bool es_registra_faixa(es_t *self, dispositivo_id_t primeiro, int n,
+                       void *controladora, int id,
+                       f_leitura_t f_leitura, f_escrita_t f_escrita)
+{
+  if (primeiro < 0 || n < 0 || primeiro + n > self->n_dispositivos) return false;
+  for (int i = 0; i < n; i++) {
+    es_registra_dispositivo(self, primeiro + i, controladora, id + i,
+                            f_leitura, f_escrita);
+  }
   return true;
 }
 
+// todo dispositivo tem as duas funções (as que faltam são substituídas na
+//   criação e no registro), só é preciso testar o número do dispositivo
+//   (a conversão para unsigned testa os dois limites em uma comparação)
 err_t es_le(es_t *self, dispositivo_id_t dispositivo, int *pvalor)
 {
-  if (dispositivo < 0 || dispositivo >= N_DISPOSITIVOS) return ERR_DISP_INV;
-  if (self->dispositivos[dispositivo].f_leitura == NULL) return ERR_OP_INV;
-  void *controladora = self->dispositivos[dispositivo].controladora;
-  int id = self->dispositivos[dispositivo].id;
-  return self->dispositivos[dispositivo].f_leitura(controladora, id, pvalor);
+  if ((unsigned)dispositivo >= (unsigned)self->n_dispositivos) return ERR_DISP_INV;
+  dispositivo_t *disp = &self->dispositivos[dispositivo];
+  return disp->f_leitura(disp->controladora, disp->id, pvalor);
 }
 
 err_t es_escreve(es_t *self, dispositivo_id_t dispositivo, int valor)
 {
-  if (dispositivo < 0 || dispositivo >= N_DISPOSITIVOS) return ERR_DISP_INV;
-  if (self->dispositivos[dispositivo].f_escrita == NULL) return ERR_OP_INV;
-  void *controladora = self->dispositivos[dispositivo].controladora;
-  int id = self->dispositivos[dispositivo].id;
-  return self->dispositivos[dispositivo].f_escrita(controladora, id, valor);
+  if ((unsigned)dispositivo >= (unsigned)self->n_dispositivos) return ERR_DISP_INV;
+  dispositivo_t *disp = &self->dispositivos[dispositivo];
+  return disp->f_escrita(disp->controladora, disp->id, valor);
 }
@@ -25,9 +25,10 @@ typedef struct es_t es_t; // declara o tipo como sendo uma estrutura opaca
 typedef err_t (*f_leitura_t)(void *controladora, int id, int *endereco);
 typedef err_t (*f_escrita_t)(void *controladora, int id, int valor);
 
-// aloca e inicializa um controlador de E/S
+// aloca e inicializa um controlador de E/S, com 'n_dispositivos' dispositivos
+//   (numerados de 0 a n_dispositivos-1; ver N_DISPOSITIVOS_COM_TERMINAIS)
 // retorna NULL em caso de erro
-es_t *es_cria(void);
+es_t *es_cria(int n_dispositivos);
 
 // libera os recursos ocupados pelo controlador
 void es_destroi(es_t *self);
@@ -44,16 +45,25 @@ bool es_registra_dispositivo(es_t *self, dispositivo_id_t dispositivo,
                              void *controladora, int id,
                              f_leitura_t f_leitura, f_escrita_t f_escrita);
 
+// registra 'n' dispositivos consecutivos, a partir de 'primeiro', todos da
+//   mesma controladora, que os identifica por 'id', id+1, ..., id+n-1
+// retorna false se não foi possível registrar (nenhum é registrado)
+bool es_registra_faixa(es_t *self, dispositivo_id_t primeiro, int n,
+                       void *controladora, int id,
+                       f_leitura_t f_leitura, f_escrita_t f_escrita);
+
 // lê um inteiro de um dispositivo
 // retorna ERR_OK se bem sucedido, ou
 //   ERR_DISP_INV se dispositivo desconhecido
 //   ERR_OP_INV se operação inválida
+//   ERR_OCUP se o dispositivo não estiver pronto (ex: teclado sem dado)
 err_t es_le(es_t *self, dispositivo_id_t dispositivo, int *pvalor);
 
 // escreve um inteiro em um dispositivo
 // retorna ERR_OK se bem sucedido, ou
 //   ERR_DISP_INV se dispositivo desconhecido
 //   ERR_OP_INV se operação inválida
+//   ERR_OCUP se o dispositivo não estiver pronto (ex: tela ocupada)
 err_t es_escreve(es_t *self, dispositivo_id_t dispositivo, int valor);
 
 #endif // ES_H
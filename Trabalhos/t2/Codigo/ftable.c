@@ -0,0 +1,361 @@
+#include "ftable.h"
+#include "tabpag.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct frame {
+    process_t *owner;
+    int page;
+    // processos que mapeiam o quadro (o dono é um deles), 'sharers' deles;
+    //   os bits de acesso e alteração do quadro são os de todos eles
+    process_t **mappers;
+    int sharers;
+    int cap_mappers;
+    bool locked;
+    // fixado pelo SO enquanto a instrução que usa a página não termina
+    bool pinned;
+    // página recém carregada, que o processo ainda não acessou
+    bool fresh;
+    // ordem em que a página foi carregada (FIFO e desempate)
+    unsigned long loaded;
+    // contador de aging, o bit mais significativo é a amostra mais recente
+    unsigned char age;
+} frame_t;
+
+struct ftable {
+    int n_frames;
+    int first_frame;
+    policy_t policy;
+    frame_t *frames;
+    unsigned long n_loaded;
+    // ponteiro do relógio (clock) e início da busca do NRU
+    int hand;
+    // se as páginas recém carregadas ficam de fora da escolha da vítima
+    bool protect_fresh;
+};
+
+static char *policy_names[] = {
+    [pol_fifo] = "fifo",
+    [pol_clock] = "clock",
+    [pol_nru] = "nru",
+    [pol_aging] = "aging",
+};
+#define N_POLICIES (sizeof(policy_names) / sizeof(policy_names[0]))
+
+ftable_t *ftable_create(int n_frames, int first_frame, policy_t policy) {
+    ftable_t *ftbl = calloc(1, sizeof(ftable_t));
+    assert(ftbl != NULL);
+
+    ftbl->n_frames = n_frames;
+    ftbl->first_frame = first_frame;
+    ftbl->policy = policy;
+    ftbl->frames = calloc(n_frames, sizeof(frame_t));
+    assert(ftbl->frames != NULL);
+    ftbl->hand = first_frame;
+
+    return ftbl;
+}
+
+void ftable_free(ftable_t *ftbl) {
+    for (int i = 0; i < ftbl->n_frames; i++) {
+        free(ftbl->frames[i].mappers);
+    }
+    free(ftbl->frames);
+    free(ftbl);
+}
+
+bool ftable_policy_by_name(char *name, policy_t *ppolicy) {
+    for (int i = 0; i < N_POLICIES; i++) {
+        if (strcmp(name, policy_names[i]) == 0) {
+            *ppolicy = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+char *ftable_policy_name(policy_t policy) {
+    return policy_names[policy];
+}
+
+void ftable_set_policy(ftable_t *ftbl, policy_t policy) {
+    ftbl->policy = policy;
+}
+
+policy_t ftable_policy(ftable_t *ftbl) {
+    return ftbl->policy;
+}
+
+int ftable_find_free(ftable_t *ftbl) {
+    for (int i = ftbl->first_frame; i < ftbl->n_frames; i++) {
+        if (!ftbl->frames[i].owner) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void ftable_occupy(ftable_t *ftbl, int frame, process_t *owner, int page) {
+    frame_t *f = &ftbl->frames[frame];
+    f->owner = owner;
+    f->page = page;
+    f->sharers = 0;
+    ftable_share(ftbl, frame, owner);
+    f->locked = false;
+    f->fresh = true;
+    f->loaded = ++ftbl->n_loaded;
+    // uma página recém carregada foi acessada agora
+    f->age = 0x80;
+}
+
+void ftable_release(ftable_t *ftbl, int frame) {
+    ftbl->frames[frame].owner = NULL;
+    ftbl->frames[frame].sharers = 0;
+    ftbl->frames[frame].locked = false;
+    ftbl->frames[frame].pinned = false;
+}
+
+void ftable_lock(ftable_t *ftbl, int frame, bool locked) {
+    ftbl->frames[frame].locked = locked;
+}
+
+bool ftable_locked(ftable_t *ftbl, int frame) {
+    return ftbl->frames[frame].locked;
+}
+
+void ftable_pin(ftable_t *ftbl, int frame) {
+    ftbl->frames[frame].pinned = true;
+}
+
+bool ftable_pinned(ftable_t *ftbl, int frame) {
+    return ftbl->frames[frame].pinned;
+}
+
+void ftable_unpin_all(ftable_t *ftbl) {
+    for (int i = ftbl->first_frame; i < ftbl->n_frames; i++) {
+        ftbl->frames[i].pinned = false;
+    }
+}
+
+void ftable_release_process(ftable_t *ftbl, process_t *owner) {
+    for (int i = ftbl->first_frame; i < ftbl->n_frames; i++) {
+        if (ftbl->frames[i].owner == owner) {
+            ftable_release(ftbl, i);
+        }
+    }
+}
+
+process_t *ftable_owner(ftable_t *ftbl, int frame) {
+    return ftbl->frames[frame].owner;
+}
+
+int ftable_page(ftable_t *ftbl, int frame) {
+    return ftbl->frames[frame].page;
+}
+
+void ftable_set_owner(ftable_t *ftbl, int frame, process_t *owner) {
+    ftbl->frames[frame].owner = owner;
+}
+
+int ftable_sharers(ftable_t *ftbl, int frame) {
+    return ftbl->frames[frame].sharers;
+}
+
+process_t *ftable_sharer(ftable_t *ftbl, int frame, int i) {
+    return ftbl->frames[frame].mappers[i];
+}
+
+void ftable_share(ftable_t *ftbl, int frame, process_t *proc) {
+    frame_t *f = &ftbl->frames[frame];
+    if (f->sharers == f->cap_mappers) {
+        f->cap_mappers = f->cap_mappers ? 2 * f->cap_mappers : 4;
+        f->mappers = realloc(f->mappers, f->cap_mappers * sizeof(process_t *));
+        assert(f->mappers != NULL);
+    }
+    f->mappers[f->sharers++] = proc;
+}
+
+int ftable_unshare(ftable_t *ftbl, int frame, process_t *proc) {
+    frame_t *f = &ftbl->frames[frame];
+    for (int i = 0; i < f->sharers; i++) {
+        if (f->mappers[i] == proc) {
+            f->mappers[i] = f->mappers[--f->sharers];
+            break;
+        }
+    }
+    return f->sharers;
+}
+
+// um quadro compartilhado foi acessado se algum dos processos que o mapeiam
+//   acessou a página
+static bool frame_accessed(frame_t *f) {
+    for (int i = 0; i < f->sharers; i++) {
+        if (tabpag_bit_acesso(process_tabpag(f->mappers[i]), f->page)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// se o quadro pode ser escolhido para substituição
+// uma página recém carregada só pode ser escolhida depois que o processo a
+//   acessar (senão, com os bits de acesso e alteração zerados, ela seria a
+//   próxima vítima do NRU, antes de o processo voltar a executar), a menos
+//   que só tenham sobrado quadros com páginas assim
+static bool frame_evictable(ftable_t *ftbl, frame_t *f) {
+    if (!f->owner || f->locked || f->pinned) {
+        return false;
+    }
+    if (f->fresh && frame_accessed(f)) {
+        f->fresh = false;
+    }
+    return !f->fresh || !ftbl->protect_fresh;
+}
+
+static bool frame_modified(frame_t *f) {
+    for (int i = 0; i < f->sharers; i++) {
+        if (tabpag_bit_alteracao(process_tabpag(f->mappers[i]), f->page)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void frame_clear_access(frame_t *f) {
+    f->fresh = false;
+    for (int i = 0; i < f->sharers; i++) {
+        tabpag_zera_bit_acesso(process_tabpag(f->mappers[i]), f->page);
+    }
+}
+
+// avança o ponteiro circular, pulando os quadros reservados
+static int ftable_next(ftable_t *ftbl, int frame) {
+    frame++;
+    if (frame >= ftbl->n_frames) {
+        frame = ftbl->first_frame;
+    }
+    return frame;
+}
+
+// quadro ocupado há mais tempo
+static int ftable_victim_fifo(ftable_t *ftbl) {
+    int victim = -1;
+    for (int i = ftbl->first_frame; i < ftbl->n_frames; i++) {
+        frame_t *f = &ftbl->frames[i];
+        if (frame_evictable(ftbl, f) && (victim < 0 || f->loaded < ftbl->frames[victim].loaded)) {
+            victim = i;
+        }
+    }
+    return victim;
+}
+
+// segunda chance: percorre os quadros circularmente, zerando o bit de acesso
+//   dos acessados, até achar um não acessado
+static int ftable_victim_clock(ftable_t *ftbl) {
+    // em 2 voltas sempre acha, porque a primeira zera todos os bits
+    int n = 2 * (ftbl->n_frames - ftbl->first_frame);
+    for (int i = 0; i < n; i++) {
+        int frame = ftbl->hand;
+        frame_t *f = &ftbl->frames[frame];
+        ftbl->hand = ftable_next(ftbl, frame);
+        if (!frame_evictable(ftbl, f)) {
+            continue;
+        }
+        if (!frame_accessed(f)) {
+            return frame;
+        }
+        frame_clear_access(f);
+    }
+    return -1;
+}
+
+// NRU: escolhe um quadro da menor classe (acesso * 2 + alteração), começando
+//   a busca de onde parou a anterior, para não escolher sempre os mesmos
+static int ftable_victim_nru(ftable_t *ftbl) {
+    int victim = -1;
+    int victim_class = 4;
+    int frame = ftbl->hand;
+    for (int i = ftbl->first_frame; i < ftbl->n_frames; i++) {
+        frame_t *f = &ftbl->frames[frame];
+        if (frame_evictable(ftbl, f)) {
+            int class = frame_accessed(f) * 2 + frame_modified(f);
+            if (class < victim_class) {
+                victim = frame;
+                victim_class = class;
+                if (class == 0) {
+                    break;
+                }
+            }
+        }
+        frame = ftable_next(ftbl, frame);
+    }
+    if (victim >= 0) {
+        ftbl->hand = ftable_next(ftbl, victim);
+    }
+    return victim;
+}
+
+// aging: o de menor contador (menos usado recentemente); desempata por FIFO
+static int ftable_victim_aging(ftable_t *ftbl) {
+    int victim = -1;
+    for (int i = ftbl->first_frame; i < ftbl->n_frames; i++) {
+        frame_t *f = &ftbl->frames[i];
+        if (!frame_evictable(ftbl, f)) {
+            continue;
+        }
+        if (victim < 0) {
+            victim = i;
+            continue;
+        }
+        frame_t *v = &ftbl->frames[victim];
+        if (f->age < v->age || (f->age == v->age && f->loaded < v->loaded)) {
+            victim = i;
+        }
+    }
+    return victim;
+}
+
+static int ftable_victim(ftable_t *ftbl) {
+    switch (ftbl->policy) {
+    case pol_fifo:
+        return ftable_victim_fifo(ftbl);
+    case pol_clock:
+        return ftable_victim_clock(ftbl);
+    case pol_nru:
+        return ftable_victim_nru(ftbl);
+    case pol_aging:
+        return ftable_victim_aging(ftbl);
+    }
+    return -1;
+}
+
+int ftable_choose_victim(ftable_t *ftbl) {
+    ftbl->protect_fresh = true;
+    int victim = ftable_victim(ftbl);
+    if (victim < 0) {
+        ftbl->protect_fresh = false;
+        victim = ftable_victim(ftbl);
+    }
+    return victim;
+}
+
+void ftable_tick(ftable_t *ftbl) {
+    if (ftbl->policy != pol_aging && ftbl->policy != pol_nru) {
+        return;
+    }
+    for (int i = ftbl->first_frame; i < ftbl->n_frames; i++) {
+        frame_t *f = &ftbl->frames[i];
+        if (!f->owner) {
+            continue;
+        }
+        bool accessed = frame_accessed(f);
+        if (ftbl->policy == pol_aging) {
+            f->age = (f->age >> 1) | (accessed ? 0x80 : 0);
+        }
+        if (accessed) {
+            frame_clear_access(f);
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef FTABLE_H
+#define FTABLE_H
+
+#include "ptable.h"
+#include <stdbool.h>
+
+// Tabela de quadros da memória principal.
+// Guarda, para cada quadro, o processo dono e a página dele que está no
+//   quadro, e escolhe o quadro a liberar quando não tem quadro livre, de
+//   acordo com a política de substituição.
+// Os quadros antes de first_frame são reservados (SO), não são controlados.
+// Um quadro pode estar mapeado por mais de um processo (páginas compartilhadas
+//   de um mesmo programa); o dono é um deles. Os bits de acesso e alteração
+//   usados na substituição são os das tabelas de páginas de todos eles.
+
+typedef enum policy { pol_fifo, pol_clock, pol_nru, pol_aging } policy_t;
+
+typedef struct ftable ftable_t;
+
+ftable_t *ftable_create(int n_frames, int first_frame, policy_t policy);
+void ftable_free(ftable_t *ftbl);
+
+// converte entre o nome da política ("fifo", "clock", "nru", "aging") e o valor
+bool ftable_policy_by_name(char *name, policy_t *ppolicy);
+char *ftable_policy_name(policy_t policy);
+
+void ftable_set_policy(ftable_t *ftbl, policy_t policy);
+policy_t ftable_policy(ftable_t *ftbl);
+
+// retorna um quadro livre, ou -1 se não tiver
+int ftable_find_free(ftable_t *ftbl);
+// escolhe um quadro ocupado para ser liberado, de acordo com a política
+// usa (e pode zerar) os bits de acesso na tabela de páginas dos donos
+// retorna -1 se não tiver quadro ocupado e destravado
+int ftable_choose_victim(ftable_t *ftbl);
+
+// registra que a página 'page' do processo 'owner' foi colocada em 'frame'
+void ftable_occupy(ftable_t *ftbl, int frame, process_t *owner, int page);
+// registra que 'frame' está livre
+void ftable_release(ftable_t *ftbl, int frame);
+// trava ou destrava um quadro; um quadro travado (com transferência em
+//   andamento) não é escolhido para substituição
+void ftable_lock(ftable_t *ftbl, int frame, bool locked);
+bool ftable_locked(ftable_t *ftbl, int frame);
+// fixa um quadro, que não é escolhido para substituição até ser desfixado;
+//   independente da trava, que é da transferência
+void ftable_pin(ftable_t *ftbl, int frame);
+bool ftable_pinned(ftable_t *ftbl, int frame);
+void ftable_unpin_all(ftable_t *ftbl);
+// libera todos os quadros de um processo
+void ftable_release_process(ftable_t *ftbl, process_t *owner);
+
+// dono de um quadro (NULL se livre ou reservado) e página que está nele
+process_t *ftable_owner(ftable_t *ftbl, int frame);
+int ftable_page(ftable_t *ftbl, int frame);
+// troca o dono de um quadro compartilhado (a página continua a mesma)
+void ftable_set_owner(ftable_t *ftbl, int frame, process_t *owner);
+
+// número de processos que mapeiam o quadro (1 depois de ftable_occupy)
+int ftable_sharers(ftable_t *ftbl, int frame);
+// o i-ésimo processo que mapeia o quadro (0 <= i < ftable_sharers)
+process_t *ftable_sharer(ftable_t *ftbl, int frame, int i);
+// registra que mais um processo, 'proc', mapeia o quadro
+void ftable_share(ftable_t *ftbl, int frame, process_t *proc);
+// registra que 'proc' deixou de mapear o quadro, que continua ocupado
+//   pelos outros; retorna quantos ainda mapeiam
+int ftable_unshare(ftable_t *ftbl, int frame, process_t *proc);
+
+// deve ser chamada periodicamente (a cada interrupção do relógio)
+// para aging, amostra os bits de acesso nos contadores; para NRU, zera os bits
+//   de acesso, para que fiquem marcadas só as páginas usadas recentemente
+void ftable_tick(ftable_t *ftbl);
+
+#endif // FTABLE_H
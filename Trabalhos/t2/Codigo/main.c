@@ -16,9 +16,38 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
 
 // constantes
-#define MEM_TAM 10000        // tamanho da memória principal
+#define MEM_TAM 10000        // tamanho padrão da memória principal
+#define N_TERMINAIS 4        // número padrão de terminais (A a D)
+
+// opções de execução, definidas pelos argumentos da linha de comando
+typedef struct {
+  // executa sem tela, sem esperar comandos do operador
+  bool modo_lote;
+  // limite de instruções no modo lote (0 = sem limite)
+  long max_instrucoes;
+  // a cada quantas instruções atualiza a console (0 = nunca)
+  int intervalo_atualizacao;
+  // configuração da TLB (tlb_conjuntos < 0 mantém a configuração padrão)
+  int tlb_conjuntos, tlb_vias, tlb_asid;
+  // tamanho da memória principal
+  int mem_tam;
+  // política de substituição de páginas do SO (NULL para a padrão)
+  char *politica;
+  // tempo de transferência de uma página de/para o disco (< 0 para o padrão)
+  int tempo_troca;
+  // tempo em que a saída de um terminal fica ocupada a cada caractere
+  int tempo_por_char;
+  // número de terminais
+  int n_terminais;
+  // nomes dos arquivos de entrada e saída de cada terminal (ou NULL)
+  char *arq_entrada[MAX_TERMINAIS];
+  char *arq_saida[MAX_TERMINAIS];
+} opcoes_t;
 
 // estrutura com os componentes do computador simulado
 typedef struct {
@@ -29,52 +58,181 @@ typedef struct {
   console_t *console;
   es_t *es;
   controle_t *controle;
+  // arquivos associados aos terminais
+  FILE *arquivos[2 * MAX_TERMINAIS];
+  int n_arquivos;
 } hardware_t;
 
-static void cria_hardware(hardware_t *hw)
+static void uso(char *nome)
+{
+  fprintf(stderr, "uso: %s [-l] [-m max_instr] [-n intervalo] "
+                  "[-t conj,vias[,asid]] [-M tam_mem] [-p politica] [-d tempo] "
+                  "[-b tempo] [-T n_term] [-e T:arquivo] [-s T:arquivo]\n", nome);
+  fprintf(stderr, "  -l            modo lote: executa sem tela, até o fim\n");
+  fprintf(stderr, "  -m max_instr  no modo lote, termina após max_instr instruções\n");
+  fprintf(stderr, "  -n intervalo  atualiza a console a cada 'intervalo' instruções"
+                  " (0: nunca)\n");
+  fprintf(stderr, "  -t conj,vias[,asid]  configura a TLB (conj=0: sem TLB;"
+                  " asid=0: esvazia na troca de processo)\n");
+  fprintf(stderr, "  -M tam_mem    tamanho da memória principal (padrão %d;"
+                  " múltiplo de %d, no mínimo %d)\n",
+                  MEM_TAM, TAM_PAGINA, SO_MEM_RESERVADA + SO_MIN_QUADROS * TAM_PAGINA);
+  fprintf(stderr, "  -p politica   substituição de páginas: fifo, clock, nru ou"
+                  " aging\n");
+  fprintf(stderr, "  -d tempo      tempo de transferência de uma página do disco"
+                  " (0: sem espera)\n");
+  fprintf(stderr, "  -b tempo      tempo em que a tela de um terminal fica ocupada"
+                  " a cada caractere (0: nunca)\n");
+  fprintf(stderr, "  -T n_term     número de terminais (padrão %d, máximo %d)\n",
+                  N_TERMINAIS, MAX_TERMINAIS);
+  fprintf(stderr, "  -e T:arquivo  alimenta a entrada do terminal T com o arquivo\n");
+  fprintf(stderr, "  -s T:arquivo  copia a saída do terminal T para o arquivo\n");
+  exit(1);
+}
+
+// interpreta um argumento no formato "T:arquivo", coloca o nome do arquivo
+//   na posição correspondente ao terminal T em 'nomes'
+static void pega_arquivo_de_terminal(char *nome, char *arg, char *nomes[])
+{
+  int t = toupper(arg[0]) - 'A';
+  if (t < 0 || t >= MAX_TERMINAIS || arg[1] != ':' || arg[2] == '\0') uso(nome);
+  nomes[t] = &arg[2];
+}
+
+static void pega_opcoes(int argc, char *argv[], opcoes_t *op)
+{
+  memset(op, 0, sizeof(*op));
+  op->intervalo_atualizacao = 1;
+  op->tlb_conjuntos = -1;
+  op->mem_tam = MEM_TAM;
+  op->tempo_troca = -1;
+  op->n_terminais = N_TERMINAIS;
+  int opt;
+  while ((opt = getopt(argc, argv, "lm:n:t:M:p:d:b:T:e:s:")) != -1) {
+    switch (opt) {
+      case 'l':
+        op->modo_lote = true;
+        op->intervalo_atualizacao = 0;
+        break;
+      case 'm':
+        op->max_instrucoes = atol(optarg);
+        break;
+      case 'n':
+        op->intervalo_atualizacao = atoi(optarg);
+        break;
+      case 't':
+        op->tlb_asid = 1;
+        if (sscanf(optarg, "%d,%d,%d", &op->tlb_conjuntos, &op->tlb_vias,
+                   &op->tlb_asid) < 2) {
+          uso(argv[0]);
+        }
+        break;
+      case 'M':
+        op->mem_tam = atoi(optarg);
+        // só quadros inteiros, e os que os processos precisam além da área
+        //   reservada
+        if (op->mem_tam % TAM_PAGINA != 0
+            || op->mem_tam < SO_MEM_RESERVADA + SO_MIN_QUADROS * TAM_PAGINA) {
+          uso(argv[0]);
+        }
+        break;
+      case 'p':
+        op->politica = optarg;
+        break;
+      case 'd':
+        op->tempo_troca = atoi(optarg);
+        if (op->tempo_troca < 0) uso(argv[0]);
+        break;
+      case 'b':
+        op->tempo_por_char = atoi(optarg);
+        if (op->tempo_por_char < 0) uso(argv[0]);
+        break;
+      case 'T':
+        op->n_terminais = atoi(optarg);
+        if (op->n_terminais <= 0 || op->n_terminais > MAX_TERMINAIS) {
+          uso(argv[0]);
+        }
+        break;
+      case 'e':
+        pega_arquivo_de_terminal(argv[0], optarg, op->arq_entrada);
+        break;
+      case 's':
+        pega_arquivo_de_terminal(argv[0], optarg, op->arq_saida);
+        break;
+      default:
+        uso(argv[0]);
+    }
+  }
+  // só pode ter arquivos para os terminais que existem
+  for (int t = op->n_terminais; t < MAX_TERMINAIS; t++) {
+    if (op->arq_entrada[t] != NULL || op->arq_saida[t] != NULL) uso(argv[0]);
+  }
+  // no modo interativo, a tela tem que ser atualizada
+  if (!op->modo_lote && op->intervalo_atualizacao <= 0) {
+    op->intervalo_atualizacao = 1;
+  }
+}
+
+static FILE *abre_arquivo(hardware_t *hw, char *nome, char *modo)
+{
+  if (nome == NULL) return NULL;
+  FILE *arq = fopen(nome, modo);
+  if (arq == NULL) {
+    perror(nome);
+    exit(1);
+  }
+  hw->arquivos[hw->n_arquivos++] = arq;
+  return arq;
+}
+
+// associa os arquivos de entrada e saída aos terminais, e define a velocidade
+//   da saída deles
+static void configura_terminais(hardware_t *hw, opcoes_t *op)
+{
+  hw->n_arquivos = 0;
+  for (int t = 0; t < op->n_terminais; t++) {
+    FILE *entrada = abre_arquivo(hw, op->arq_entrada[t], "r");
+    FILE *saida = abre_arquivo(hw, op->arq_saida[t], "w");
+    terminal_t *terminal = console_terminal(hw->console, 'A' + t);
+    terminal_define_arquivos(terminal, entrada, saida);
+    terminal_define_tempo_por_char(terminal, op->tempo_por_char);
+  }
+}
+
+static void cria_hardware(hardware_t *hw, opcoes_t *op)
 {
   // cria a memória e a MMU
-  hw->mem = mem_cria(MEM_TAM);
+  hw->mem = mem_cria(op->mem_tam);
   hw->mmu = mmu_cria(hw->mem);
+  if (op->tlb_conjuntos >= 0) {
+    mmu_configura_tlb(hw->mmu, op->tlb_conjuntos, op->tlb_vias, op->tlb_asid);
+  }
 
   // cria dispositivos de E/S
-  hw->console = console_cria();
+  hw->console = console_cria(!op->modo_lote, op->n_terminais);
   hw->relogio = relogio_cria();
+  configura_terminais(hw, op);
 
   // cria o controlador de E/S e registra os dispositivos
   //   por exemplo, o dispositivo 8 do controlador de E/S (e da CPU) será o
   //   dispositivo 0 do relógio (que é o contador de instruções)
-  hw->es = es_cria();
-  // lê teclado, testa teclado, escreve tela, testa tela do terminal A
-  terminal_t *terminal;
-  terminal = console_terminal(hw->console, 'A');
-  es_registra_dispositivo(hw->es, D_TERM_A_TECLADO    , terminal, 0, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_A_TECLADO_OK , terminal, 1, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_A_TELA       , terminal, 2, NULL, terminal_escrita);
-  es_registra_dispositivo(hw->es, D_TERM_A_TELA_OK    , terminal, 3, terminal_leitura, NULL);
-  // lê teclado, testa teclado, escreve tela, testa tela do terminal B
-  terminal = console_terminal(hw->console, 'B');
-  es_registra_dispositivo(hw->es, D_TERM_B_TECLADO    , terminal, 0, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_B_TECLADO_OK , terminal, 1, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_B_TELA       , terminal, 2, NULL, terminal_escrita);
-  es_registra_dispositivo(hw->es, D_TERM_B_TELA_OK    , terminal, 3, terminal_leitura, NULL);
-  // lê teclado, testa teclado, escreve tela, testa tela do terminal C
-  terminal = console_terminal(hw->console, 'C');
-  es_registra_dispositivo(hw->es, D_TERM_C_TECLADO    , terminal, 0, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_C_TECLADO_OK , terminal, 1, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_C_TELA       , terminal, 2, NULL, terminal_escrita);
-  es_registra_dispositivo(hw->es, D_TERM_C_TELA_OK    , terminal, 3, terminal_leitura, NULL);
-  // lê teclado, testa teclado, escreve tela, testa tela do terminal D
-  terminal = console_terminal(hw->console, 'D');
-  es_registra_dispositivo(hw->es, D_TERM_D_TECLADO    , terminal, 0, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_D_TECLADO_OK , terminal, 1, terminal_leitura, NULL);
-  es_registra_dispositivo(hw->es, D_TERM_D_TELA       , terminal, 2, NULL, terminal_escrita);
-  es_registra_dispositivo(hw->es, D_TERM_D_TELA_OK    , terminal, 3, terminal_leitura, NULL);
+  hw->es = es_cria(N_DISPOSITIVOS_COM_TERMINAIS(op->n_terminais));
+  // lê teclado, testa teclado, escreve tela, testa tela de cada terminal
+  //   (ver D_TERMINAL em dispositivos.h)
+  for (int t = 0; t < op->n_terminais; t++) {
+    terminal_t *terminal = console_terminal(hw->console, 'A' + t);
+    es_registra_dispositivo(hw->es, D_TERMINAL(t, D_TERM_A_TECLADO), terminal, 0, terminal_leitura, NULL);
+    es_registra_dispositivo(hw->es, D_TERMINAL(t, D_TERM_A_TECLADO_OK), terminal, 1, terminal_leitura, NULL);
+    es_registra_dispositivo(hw->es, D_TERMINAL(t, D_TERM_A_TELA), terminal, 2, NULL, terminal_escrita);
+    es_registra_dispositivo(hw->es, D_TERMINAL(t, D_TERM_A_TELA_OK), terminal, 3, terminal_leitura, NULL);
+  }
   // lê relógio virtual, relógio real
   es_registra_dispositivo(hw->es, D_RELOGIO_INSTRUCOES, hw->relogio, 0, relogio_leitura, NULL);
   es_registra_dispositivo(hw->es, D_RELOGIO_REAL      , hw->relogio, 1, relogio_leitura, NULL);
   es_registra_dispositivo(hw->es, D_RELOGIO_TIMER     , hw->relogio, 2, relogio_leitura, relogio_escrita);
   es_registra_dispositivo(hw->es, D_RELOGIO_INTERRUPCAO,hw->relogio, 3, relogio_leitura, relogio_escrita);
+  // interrupções dos terminais (teclado e tela)
+  es_registra_faixa(hw->es, D_TERM_INT_TECLADO, 2, hw->console, 0, console_leitura, console_escrita);
 
   // cria a unidade de execução e inicializa com a MMU e E/S
   hw->cpu = cpu_cria(hw->mmu, hw->es);
@@ -82,6 +240,11 @@ static void cria_hardware(hardware_t *hw)
   // cria o controlador da CPU e inicializa com a unidade de execução, a console e
   //   o relógio
   hw->controle = controle_cria(hw->cpu, hw->console, hw->relogio);
+  if (op->modo_lote) {
+    controle_define_modo_lote(hw->controle, op->max_instrucoes);
+  }
+  controle_define_intervalo_de_atualizacao(hw->controle,
+                                           op->intervalo_atualizacao);
 }
 
 static void destroi_hardware(hardware_t *hw)
@@ -93,21 +256,39 @@ static void destroi_hardware(hardware_t *hw)
   console_destroi(hw->console);
   mmu_destroi(hw->mmu);
   mem_destroi(hw->mem);
+  for (int i = 0; i < hw->n_arquivos; i++) {
+    fclose(hw->arquivos[i]);
+  }
 }
 
-int main()
+int main(int argc, char *argv[])
 {
   hardware_t hw;
+  opcoes_t op;
   so_t *so;
 
+  pega_opcoes(argc, argv, &op);
+
   // cria o hardware
-  cria_hardware(&hw);
+  cria_hardware(&hw, &op);
   // cria o sistema operacional
   so = so_cria(hw.cpu, hw.mem, hw.mmu, hw.es, hw.console);
+  if (op.politica != NULL && !so_define_politica_de_substituicao(so, op.politica)) {
+    console_printf("Política de substituição '%s' desconhecida", op.politica);
+  }
+  if (op.tempo_troca >= 0) {
+    so_define_tempo_de_troca(so, op.tempo_troca);
+  }
   
   // executa o laço principal do controlador
   controle_laco(hw.controle);
 
+  mmu_estat_tlb_t tlb;
+  mmu_estat_tlb(hw.mmu, &tlb);
+  console_printf("TLB: %ld acertos, %ld faltas, %ld esvaziamentos, "
+                 "%ld invalidações",
+                 tlb.acertos, tlb.faltas, tlb.esvaziamentos, tlb.invalidacoes);
+
   // destroi tudo
   so_destroi(so);
   destroi_hardware(&hw);
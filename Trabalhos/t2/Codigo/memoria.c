@@ -6,12 +6,19 @@
 #include "memoria.h"
 
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 // tipo de dados para representar uma região de memória
 struct mem_t {
   int tam;
   int *conteudo;
+  // se o conteúdo está mapeado de um arquivo (senão, foi alocado)
+  bool mapeada;
 };
 
 mem_t *mem_cria(int tam)
@@ -24,6 +31,33 @@ mem_t *mem_cria(int tam)
   assert(self->conteudo != NULL);
 
   self->tam = tam;
+  self->mapeada = false;
+
+  return self;
+}
+
+mem_t *mem_cria_arquivo(int tam, char *nome)
+{
+  size_t bytes = (size_t)tam * sizeof(int);
+  int fd = open(nome, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return NULL;
+  // o arquivo truncado e estendido é esparso, lido como zeros
+  if (ftruncate(fd, bytes) != 0) {
+    close(fd);
+    return NULL;
+  }
+  int *conteudo = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  // o mapeamento continua valendo depois de fechar o descritor
+  close(fd);
+  if (conteudo == MAP_FAILED) return NULL;
+
+  mem_t *self;
+  self = malloc(sizeof(*self));
+  assert(self != NULL);
+
+  self->conteudo = conteudo;
+  self->tam = tam;
+  self->mapeada = true;
 
   return self;
 }
@@ -31,7 +65,9 @@ mem_t *mem_cria(int tam)
 void mem_destroi(mem_t *self)
 {
   if (self != NULL) {
-    if (self->conteudo != NULL) {
+    if (self->mapeada) {
+      munmap(self->conteudo, (size_t)self->tam * sizeof(int));
+    } else if (self->conteudo != NULL) {
       free(self->conteudo);
     }
     free(self);
@@ -69,3 +105,44 @@ err_t mem_escreve(mem_t *self, int endereco, int valor)
   }
   return err;
 }
+
+// função auxiliar, verifica se todo o bloco é válido
+static err_t verifica_permissao_bloco(mem_t *self, int endereco, int tam)
+{
+  if (tam < 0 || endereco < 0 || endereco > self->tam - tam) {
+    return ERR_END_INV;
+  }
+  return ERR_OK;
+}
+
+err_t mem_le_bloco(mem_t *self, int endereco, int tam, int valores[tam])
+{
+  err_t err = verifica_permissao_bloco(self, endereco, tam);
+  if (err == ERR_OK) {
+    memcpy(valores, &self->conteudo[endereco], tam * sizeof(*valores));
+  }
+  return err;
+}
+
+err_t mem_escreve_bloco(mem_t *self, int endereco, int tam, int valores[tam])
+{
+  err_t err = verifica_permissao_bloco(self, endereco, tam);
+  if (err == ERR_OK) {
+    memcpy(&self->conteudo[endereco], valores, tam * sizeof(*valores));
+  }
+  return err;
+}
+
+err_t mem_copia_bloco(mem_t *origem, int end_origem,
+                      mem_t *destino, int end_destino, int tam)
+{
+  err_t err = verifica_permissao_bloco(origem, end_origem, tam);
+  if (err == ERR_OK) {
+    err = verifica_permissao_bloco(destino, end_destino, tam);
+  }
+  if (err == ERR_OK) {
+    memmove(&destino->conteudo[end_destino], &origem->conteudo[end_origem],
+            tam * sizeof(*origem->conteudo));
+  }
+  return err;
+}
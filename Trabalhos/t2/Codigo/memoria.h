@@ -16,6 +16,14 @@ typedef struct mem_t mem_t;
 //   as operações sobre essa memória
 mem_t *mem_cria(int tam);
 
+// cria uma região de memória com capacidade para 'tam' valores, mantida no
+//   arquivo 'nome' (mapeado em memória)
+// o arquivo é criado (ou recriado) esparso, com todos os valores 0; as
+//   páginas só ocupam espaço quando forem escritas. O arquivo permanece após
+//   a destruição da região, com o conteúdo final, para inspeção.
+// retorna NULL em caso de erro no arquivo
+mem_t *mem_cria_arquivo(int tam, char *nome);
+
 // destrói uma região de memória
 // nenhuma outra operação pode ser realizada na região após esta chamada
 void mem_destroi(mem_t *self);
@@ -31,4 +39,20 @@ err_t mem_le(mem_t *self, int endereco, int *pvalor);
 // retorna erro ERR_END_INV se endereço inválido
 err_t mem_escreve(mem_t *self, int endereco, int valor);
 
+// Operações em blocos de valores consecutivos, com uma única verificação de
+//   endereço para todo o bloco
+// retornam erro ERR_END_INV (e não fazem nada) se alguma posição do bloco for
+//   inválida
+
+// copia para 'valores' os 'tam' valores a partir do endereço 'endereco'
+err_t mem_le_bloco(mem_t *self, int endereco, int tam, int valores[tam]);
+
+// copia os 'tam' valores de 'valores' para a memória, a partir de 'endereco'
+err_t mem_escreve_bloco(mem_t *self, int endereco, int tam, int valores[tam]);
+
+// copia 'tam' valores da memória 'origem', a partir de 'end_origem', para a
+//   memória 'destino', a partir de 'end_destino' (podem ser a mesma memória)
+err_t mem_copia_bloco(mem_t *origem, int end_origem,
+                      mem_t *destino, int end_destino, int tam);
+
 #endif // MEMORIA_H
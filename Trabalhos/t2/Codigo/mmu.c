@@ -6,14 +6,51 @@
 #include "mmu.h"
 #include "console.h"
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
+// configuração inicial da TLB
+#define TLB_CONJUNTOS 8
+#define TLB_VIAS      2
+
+// uma entrada da TLB, com uma tradução copiada de uma tabela de páginas
+typedef struct {
+  bool valida;
+  // tabela de onde veio a tradução e a versão dela quando foi copiada
+  //   (a tabela identifica o processo, faz o papel de um ASID)
+  tabpag_t *tabpag;
+  unsigned versao;
+  int pagina;
+  int quadro;
+  // se a página está protegida contra escrita
+  bool protegida;
+  // se os bits de acesso e de alteração já foram marcados na tabela, e a
+  //   versão dos bits de acesso da tabela quando isso foi feito
+  bool acessada;
+  bool alterada;
+  unsigned versao_acesso;
+  // momento do último uso, para escolher a via a substituir no conjunto
+  unsigned long uso;
+} entrada_tlb_t;
+
 // tipo de dados opaco para representar uma MMU
 struct mmu_t {
   // memória física
   mem_t *mem;
   // tabela de páginas
   tabpag_t *tabpag;
+  // versão de cada quadro da memória física
+  int n_quadros;
+  unsigned *versao;
+  // para cada endereço físico, se contém código (escrita muda a versão)
+  bool *codigo;
+  // TLB, com n_conjuntos * n_vias entradas (NULL se não tiver TLB)
+  int n_conjuntos;
+  int n_vias;
+  bool asid;
+  entrada_tlb_t *tlb;
+  unsigned long n_usos;
+  mmu_estat_tlb_t estat;
 };
 
 mmu_t *mmu_cria(mem_t *mem)
@@ -23,6 +60,16 @@ mmu_t *mmu_cria(mem_t *mem)
   assert(self != NULL);
   self->mem = mem;
   self->tabpag = NULL;
+  int tam = mem_tam(mem);
+  self->n_quadros = (tam + TAM_PAGINA - 1) / TAM_PAGINA;
+  self->versao = malloc(self->n_quadros * sizeof(*self->versao));
+  self->codigo = calloc(tam, sizeof(*self->codigo));
+  assert(self->versao != NULL && self->codigo != NULL);
+  for (int q = 0; q < self->n_quadros; q++) {
+    self->versao[q] = 1;
+  }
+  self->tlb = NULL;
+  mmu_configura_tlb(self, TLB_CONJUNTOS, TLB_VIAS, true);
   return self;
 }
 
@@ -30,31 +77,227 @@ void mmu_destroi(mmu_t *self)
 {
   if (self != NULL) {
     // nem a tabela de páginas nem a memória pertencem à MMU, não são liberadas aqui
+    free(self->versao);
+    free(self->codigo);
+    free(self->tlb);
     free(self);
   }
 }
 
+int mmu_tam_memoria(mmu_t *self)
+{
+  return mem_tam(self->mem);
+}
+
+// TLB
+
+// invalida todas as entradas da TLB
+static void mmu__esvazia_tlb(mmu_t *self)
+{
+  int n = self->n_conjuntos * self->n_vias;
+  for (int i = 0; i < n; i++) {
+    self->tlb[i].valida = false;
+  }
+  self->estat.esvaziamentos++;
+}
+
+void mmu_configura_tlb(mmu_t *self, int n_conjuntos, int n_vias, bool asid)
+{
+  free(self->tlb);
+  self->tlb = NULL;
+  self->n_conjuntos = 0;
+  self->n_vias = 0;
+  self->asid = asid;
+  self->n_usos = 0;
+  self->estat = (mmu_estat_tlb_t){ 0, 0, 0, 0 };
+  if (n_conjuntos <= 0 || n_vias <= 0) return;
+  self->tlb = calloc(n_conjuntos * n_vias, sizeof(*self->tlb));
+  assert(self->tlb != NULL);
+  self->n_conjuntos = n_conjuntos;
+  self->n_vias = n_vias;
+}
+
+void mmu_estat_tlb(mmu_t *self, mmu_estat_tlb_t *estat)
+{
+  *estat = self->estat;
+}
+
+// procura a tradução de 'pagina' na TLB; retorna a entrada ou NULL
+static entrada_tlb_t *mmu__busca_tlb(mmu_t *self, int pagina)
+{
+  entrada_tlb_t *conj = &self->tlb[(pagina % self->n_conjuntos) * self->n_vias];
+  for (int via = 0; via < self->n_vias; via++) {
+    entrada_tlb_t *e = &conj[via];
+    if (e->valida && e->pagina == pagina && e->tabpag == self->tabpag) {
+      if (e->versao != tabpag_versao(self->tabpag)) {
+        // a tabela mudou depois que a tradução foi copiada
+        e->valida = false;
+        self->estat.invalidacoes++;
+        return NULL;
+      }
+      e->uso = ++self->n_usos;
+      return e;
+    }
+  }
+  return NULL;
+}
+
+// coloca a tradução de 'pagina' para 'quadro' na TLB, no lugar de uma via
+//   livre ou da menos recentemente usada do conjunto; retorna a entrada
+static entrada_tlb_t *mmu__insere_tlb(mmu_t *self, int pagina, int quadro,
+                                       bool protegida)
+{
+  entrada_tlb_t *conj = &self->tlb[(pagina % self->n_conjuntos) * self->n_vias];
+  entrada_tlb_t *e = &conj[0];
+  for (int via = 1; via < self->n_vias && e->valida; via++) {
+    if (!conj[via].valida || conj[via].uso < e->uso) e = &conj[via];
+  }
+  e->valida = true;
+  e->tabpag = self->tabpag;
+  e->versao = tabpag_versao(self->tabpag);
+  e->pagina = pagina;
+  e->quadro = quadro;
+  e->protegida = protegida;
+  e->acessada = false;
+  e->alterada = false;
+  e->uso = ++self->n_usos;
+  return e;
+}
+
 void mmu_define_tabpag(mmu_t *self, tabpag_t *tabpag)
 {
+  // sem ASID, as traduções da tabela anterior não podem ficar na TLB
+  if (tabpag != self->tabpag && self->tlb != NULL && !self->asid) {
+    mmu__esvazia_tlb(self);
+  }
   self->tabpag = tabpag;
 }
 
+// TRADUÇÃO
+
 // tradur o endereço virtual 'endvirt', colocando o endereço físico
-//   correspondente em 'pendfis'.
+//   correspondente em 'pendfis' e a entrada da TLB que contém a tradução
+//   em 'pentrada' (NULL se não tiver TLB).
+// se 'escrita', a página não pode estar protegida contra escrita
 // retorna ERR_OK ou um erro se a tradução não for possível
-static err_t mmu__traduz(mmu_t *self, int endvirt, int *pendfis)
+static err_t mmu__traduz(mmu_t *self, int endvirt, bool escrita, int *pendfis,
+                         entrada_tlb_t **pentrada)
 {
   int pagina = endvirt / TAM_PAGINA;
   int deslocamento = endvirt % TAM_PAGINA;
+  bool usa_tlb = self->tlb != NULL && endvirt >= 0;
+  *pentrada = NULL;
+  if (usa_tlb) {
+    entrada_tlb_t *e = mmu__busca_tlb(self, pagina);
+    if (e != NULL) {
+      self->estat.acertos++;
+      if (escrita && e->protegida) return ERR_PAG_PROTEGIDA;
+      *pendfis = e->quadro * TAM_PAGINA + deslocamento;
+      *pentrada = e;
+      return ERR_OK;
+    }
+    self->estat.faltas++;
+  }
   int quadro;
   err_t err = tabpag_traduz(self->tabpag, pagina, &quadro);
   if (err == ERR_OK) {
+    bool protegida = tabpag_pagina_protegida(self->tabpag, pagina);
+    if (usa_tlb) {
+      *pentrada = mmu__insere_tlb(self, pagina, quadro, protegida);
+    }
+    if (escrita && protegida) return ERR_PAG_PROTEGIDA;
     *pendfis = quadro * TAM_PAGINA + deslocamento;
   }
   // console_printf("traduzi %d (pag %d) para %d (quadro %d), err=%d", endvirt, pagina, *pendfis, quadro, err);
   return err;
 }
 
+// marca o acesso à página que contém 'endvirt' na tabela de páginas, a menos
+//   que essa marcação já tenha sido feita desde que a tradução foi para a TLB
+//   e nenhum bit de acesso da tabela tenha sido zerado depois disso
+static void mmu__marca_acesso(mmu_t *self, int endvirt, entrada_tlb_t *e,
+                              bool alteracao)
+{
+  if (e != NULL) {
+    unsigned versao_acesso = tabpag_versao_acesso(self->tabpag);
+    if (e->acessada && (e->alterada || !alteracao)
+        && e->versao_acesso == versao_acesso) return;
+    e->acessada = true;
+    if (alteracao) e->alterada = true;
+    e->versao_acesso = versao_acesso;
+  }
+  tabpag_marca_bit_acesso(self->tabpag, endvirt / TAM_PAGINA, alteracao);
+}
+
+err_t mmu_traduz(mmu_t *self, int endvirt, int *pendfis, cpu_modo_t modo)
+{
+  int endfis = endvirt;
+  entrada_tlb_t *e = NULL;
+  bool traduz = modo != supervisor && self->tabpag != NULL;
+  if (traduz) {
+    err_t err = mmu__traduz(self, endvirt, false, &endfis, &e);
+    if (err != ERR_OK) return err;
+  }
+  if (endfis < 0 || endfis >= mem_tam(self->mem)) return ERR_END_INV;
+  if (traduz) {
+    mmu__marca_acesso(self, endvirt, e, false);
+  }
+  *pendfis = endfis;
+  return ERR_OK;
+}
+
+// VERSÕES DOS QUADROS
+
+// registra uma escrita bem sucedida no endereço físico 'endfis'
+static void mmu__escreveu(mmu_t *self, int endfis)
+{
+  if (self->codigo[endfis]) {
+    self->versao[endfis / TAM_PAGINA]++;
+  }
+}
+
+unsigned mmu_versao_quadro(mmu_t *self, int quadro)
+{
+  return self->versao[quadro];
+}
+
+void mmu_marca_codigo(mmu_t *self, int endfis)
+{
+  if (endfis < 0 || endfis >= mem_tam(self->mem)) return;
+  self->codigo[endfis] = true;
+}
+
+void mmu_invalida_quadro(mmu_t *self, int quadro)
+{
+  if (quadro < 0 || quadro >= self->n_quadros) return;
+  self->versao[quadro]++;
+}
+
+// TRANSFERÊNCIA DE QUADROS
+
+err_t mmu_preenche_quadro(mmu_t *self, int quadro, mem_t *origem, int end_origem)
+{
+  if (quadro < 0 || quadro >= self->n_quadros) return ERR_END_INV;
+  int end_fis = quadro * TAM_PAGINA;
+  err_t err = mem_copia_bloco(origem, end_origem, self->mem, end_fis, TAM_PAGINA);
+  if (err == ERR_OK) {
+    // o código que estava no quadro não está mais; o novo vai ser marcado
+    //   quando for decodificado
+    memset(&self->codigo[end_fis], 0, TAM_PAGINA * sizeof(*self->codigo));
+    mmu_invalida_quadro(self, quadro);
+  }
+  return err;
+}
+
+err_t mmu_copia_quadro(mmu_t *self, int quadro, mem_t *destino, int end_destino)
+{
+  if (quadro < 0 || quadro >= self->n_quadros) return ERR_END_INV;
+  return mem_copia_bloco(self->mem, quadro * TAM_PAGINA,
+                         destino, end_destino, TAM_PAGINA);
+}
+
+// ACESSO À MEMÓRIA
+
 err_t mmu_le(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo)
 {
   // em modo supervisor ou se não tiver tabela de páginas,
@@ -63,29 +306,45 @@ err_t mmu_le(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo)
     return mem_le(self->mem, endvirt, pvalor);
   }
   int endfis;
-  err_t err = mmu__traduz(self, endvirt, &endfis);
+  entrada_tlb_t *e;
+  err_t err = mmu__traduz(self, endvirt, false, &endfis, &e);
   if (err == ERR_OK) {
     err = mem_le(self->mem, endfis, pvalor);
     if (err == ERR_OK) {
-      tabpag_marca_bit_acesso(self->tabpag, endvirt / TAM_PAGINA, false);
+      mmu__marca_acesso(self, endvirt, e, false);
     }
   }
   return err;
 }
 
+err_t mmu_espia(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo)
+{
+  if (modo == supervisor || self->tabpag == NULL) {
+    return mem_le(self->mem, endvirt, pvalor);
+  }
+  int quadro;
+  err_t err = tabpag_traduz(self->tabpag, endvirt / TAM_PAGINA, &quadro);
+  if (err != ERR_OK) return err;
+  return mem_le(self->mem, quadro * TAM_PAGINA + endvirt % TAM_PAGINA, pvalor);
+}
+
 err_t mmu_escreve(mmu_t *self, int endvirt, int valor, cpu_modo_t modo)
 {
   // em modo supervisor ou se não tiver tabela de páginas,
   //   não faz tradução de endereços, nem marca o acesso
   if (modo == supervisor || self->tabpag == NULL) {
-    return mem_escreve(self->mem, endvirt, valor);
+    err_t err = mem_escreve(self->mem, endvirt, valor);
+    if (err == ERR_OK) mmu__escreveu(self, endvirt);
+    return err;
   }
   int endfis;
-  err_t err = mmu__traduz(self, endvirt, &endfis);
+  entrada_tlb_t *e;
+  err_t err = mmu__traduz(self, endvirt, true, &endfis, &e);
   if (err == ERR_OK) {
     err = mem_escreve(self->mem, endfis, valor);
     if (err == ERR_OK) {
-      tabpag_marca_bit_acesso(self->tabpag, endvirt / TAM_PAGINA, true);
+      mmu__escreveu(self, endfis);
+      mmu__marca_acesso(self, endvirt, e, true);
     }
   }
   return err;
@@ -23,6 +23,21 @@ typedef struct mmu_t mmu_t;
 // t2: pode ser alterado para comparar configurações diferentes
 #define TAM_PAGINA 10
 
+// a MMU tem uma TLB (translation lookaside buffer), que guarda cópias das
+//   traduções usadas mais recentemente, para evitar consultas à tabela de
+//   páginas
+// a TLB é organizada em conjuntos de vias (cada via guarda uma tradução);
+//   uma página só pode estar no conjunto 'pagina % n_conjuntos', em qualquer
+//   uma das vias; com uma via por conjunto, o mapeamento é direto
+
+// estatísticas de uso da TLB
+typedef struct {
+  long acertos;       // traduções encontradas na TLB
+  long faltas;        // traduções que precisaram consultar a tabela de páginas
+  long esvaziamentos; // vezes que a TLB inteira foi invalidada
+  long invalidacoes;  // entradas descartadas porque a tabela de páginas mudou
+} mmu_estat_tlb_t;
+
 // cria uma MMU para gerenciar acessos à memória
 // retorna um ponteiro para um descritor, que deverá ser usado em todas
 //   as operações nessa MMU
@@ -34,10 +49,26 @@ mmu_t *mmu_cria(mem_t *mem);
 // nenhuma outra operação pode ser realizada na MMU após esta chamada
 void mmu_destroi(mmu_t *self);
 
+// retorna o tamanho da memória física gerenciada pela MMU
+int mmu_tam_memoria(mmu_t *self);
+
 // define a tabela de páginas a usar nas próximas traduções
 // se tabpag for NULL, os acessos serão repassados sem alteração à memória
+// se a TLB não usa ASID, a troca de tabela esvazia a TLB
 void mmu_define_tabpag(mmu_t *self, tabpag_t *tabpag);
 
+// configura a TLB com 'n_conjuntos' conjuntos de 'n_vias' vias cada
+//   (0 conjuntos desliga a TLB); zera as estatísticas
+// se 'asid' for true, cada entrada é etiquetada com a tabela de páginas de
+//   onde veio, e a TLB não precisa ser esvaziada na troca de tabela
+// a TLB se mantém coerente com as alterações na tabela de páginas usando a
+//   versão da tabela (ver tabpag_versao); zerar bits de acesso não descarta
+//   traduções, só faz a TLB voltar a marcar o acesso (ver tabpag_versao_acesso)
+void mmu_configura_tlb(mmu_t *self, int n_conjuntos, int n_vias, bool asid);
+
+// coloca em 'estat' as estatísticas de uso da TLB
+void mmu_estat_tlb(mmu_t *self, mmu_estat_tlb_t *estat);
+
 // coloca na posição apontada por 'pvalor' o valor que está na memória
 //   no endereço físico correspondente ao endereço virtual 'endvirt'
 // marca a página como acessada se o acesso for bem sucedido
@@ -52,10 +83,59 @@ err_t mmu_le(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo);
 //   virtual 'endvirt'
 // marca a página como acessada e alterada se o acesso for bem sucedido
 // retorna erro se acesso não for possível, por um erro de tradução
-//   (ver tabpag_traduz) ou de memória (ver mem_escreve)
+//   (ver tabpag_traduz), por a página estar protegida contra escrita
+//   (ERR_PAG_PROTEGIDA, ver tabpag_protege_pagina) ou de memória
+//   (ver mem_escreve)
 // se o acesso for feito em modo supervisor, ou se a mmu não tiver tabela de
 //   página definida, trata 'endvirt' como endereço físico, repassa o acesso
 //   à memória sem tradução
 err_t mmu_escreve(mmu_t *self, int endvirt, int valor, cpu_modo_t modo);
 
+// como mmu_le, mas sem efeitos colaterais: não marca o acesso na tabela de
+//   páginas, nem usa ou altera a TLB (e suas estatísticas)
+// para inspeção da memória (depuração, console), que não deve interferir
+//   nos bits de acesso usados pelo SO
+err_t mmu_espia(mmu_t *self, int endvirt, int *pvalor, cpu_modo_t modo);
+
+// traduz o endereço virtual 'endvirt' no endereço físico correspondente,
+//   colocado em '*pendfis', como se fosse para uma leitura: marca a página
+//   como acessada se a tradução for bem sucedida
+// retorna erro se a tradução não for possível (ver tabpag_traduz) ou se o
+//   endereço físico resultante não existir na memória (ERR_END_INV)
+// em modo supervisor, ou sem tabela de páginas, o endereço não é traduzido
+err_t mmu_traduz(mmu_t *self, int endvirt, int *pendfis, cpu_modo_t modo);
+
+// Transferência de quadros inteiros da memória física (usado pelo SO na troca
+//   de páginas), sem tradução nem marcação de acesso
+
+// copia para o quadro 'quadro' uma página que está na memória 'origem', a
+//   partir de 'end_origem'
+// o quadro passa a ter outro conteúdo, a versão dele muda
+// retorna erro se algum dos endereços for inválido (ver mem_copia_bloco)
+err_t mmu_preenche_quadro(mmu_t *self, int quadro, mem_t *origem, int end_origem);
+
+// copia o conteúdo do quadro 'quadro' para a memória 'destino', a partir de
+//   'end_destino'
+// retorna erro se algum dos endereços for inválido (ver mem_copia_bloco)
+err_t mmu_copia_quadro(mmu_t *self, int quadro, mem_t *destino, int end_destino);
+
+// Suporte a caches de instruções decodificadas (usado pela CPU)
+// Cada quadro da memória física tem uma versão, que muda sempre que for
+//   alterada uma posição do quadro marcada como contendo código, ou quando
+//   o quadro for explicitamente invalidado. Quem mantém informação derivada
+//   do conteúdo de um quadro compara a versão para saber se ela ainda vale.
+// Escritas feitas diretamente na memória (sem passar pela MMU) não alteram a
+//   versão; quem faz esse tipo de escrita deve invalidar o quadro.
+
+// retorna a versão atual do quadro 'quadro' (nunca é 0)
+unsigned mmu_versao_quadro(mmu_t *self, int quadro);
+
+// marca o endereço físico 'endfis' como contendo código: uma escrita nesse
+//   endereço vai mudar a versão do quadro que o contém
+void mmu_marca_codigo(mmu_t *self, int endfis);
+
+// muda a versão do quadro 'quadro' (deve ser chamada quando o conteúdo do
+//   quadro é trocado, por exemplo quando ele passa a conter outra página)
+void mmu_invalida_quadro(mmu_t *self, int quadro);
+
 #endif // MMU_H
@@ -5,6 +5,7 @@
 
 // INCLUDES {{{1
 #include "instrucao.h"
+#include "programa.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -45,6 +46,7 @@ int mem_min = -1;       // menor endereço preenchido
 int mem_max = -1;       // maior endereço preenchido
 
 char *nome_fonte;   // nome do arquivo fonte a montar
+bool saida_binaria; // gera o .maq no formato binário (ver programa.h)
 
 // coloca um valor no final da memória
 void mem_insere(int val)
@@ -79,6 +81,14 @@ void mem_imprime(void)
   }
 }
 
+// escreve 'n' inteiros de 32 bits na saída
+void escreve_int32(int n, int32_t v[n])
+{
+  if (fwrite(v, sizeof(int32_t), n, stdout) != n) {
+    erro_brabo("erro na escrita da saída");
+  }
+}
+
 // SÍMBOLOS {{{1
 
 // tabela com os símbolos (labels) já definidos pelo programa, e o valor (endereço) deles
@@ -371,12 +381,42 @@ void monta_arquivo(char *nome)
   ref_resolve();
 }
 
+// imprime a memória e a tabela de símbolos no formato binário
+void mem_imprime_binario(void)
+{
+  maq_cabecalho_t cab;
+  memcpy(cab.magico, MAQ_MAGICO, sizeof(cab.magico));
+  cab.versao = MAQ_VERSAO;
+  cab.tamanho = mem_max - mem_min + 1;
+  cab.carga = mem_min;
+  cab.n_simbolos = simb_num;
+  if (fwrite(&cab, sizeof(cab), 1, stdout) != 1) {
+    erro_brabo("erro na escrita da saída");
+  }
+  for (int i = mem_min; i <= mem_max; i++) {
+    int32_t v = mem[i];
+    escreve_int32(1, &v);
+  }
+  for (int i = 0; i < simb_num; i++) {
+    int32_t tam = strlen(simbolo[i].nome);
+    int32_t v[2] = { simbolo[i].valor, tam };
+    escreve_int32(2, v);
+    // o nome, completado com zeros até múltiplo de 4
+    char nome[tam + 4];
+    memset(nome, 0, sizeof(nome));
+    memcpy(nome, simbolo[i].nome, tam);
+    fwrite(nome, 1, (tam + 3) / 4 * 4, stdout);
+  }
+}
+
 // MAIN {{{1
 
 void verifica_args(int argc, char *argv[argc])
 {
   for (int argi = 1; argi < argc; argi++) {
-    if (strcmp(argv[argi], "-e") == 0) {
+    if (strcmp(argv[argi], "-b") == 0) {
+      saida_binaria = true;
+    } else if (strcmp(argv[argi], "-e") == 0) {
       argi++;
       if (argi >= argc) {
         fprintf(stderr, "ERRO: falta endereço após '-e'\n");
@@ -393,7 +433,7 @@ void verifica_args(int argc, char *argv[argc])
     }
   }
   if (nome_fonte == NULL) {
-    fprintf(stderr, "ERRO: chame como '%s [-e end.inicial] nome_do_arquivo'\n",
+    fprintf(stderr, "ERRO: chame como '%s [-b] [-e end.inicial] nome_do_arquivo'\n",
             argv[0]);
     exit(1);
   }
@@ -403,7 +443,11 @@ int main(int argc, char *argv[argc])
 {
   verifica_args(argc, argv);
   monta_arquivo(nome_fonte);
-  mem_imprime();
+  if (saida_binaria) {
+    mem_imprime_binario();
+  } else {
+    mem_imprime();
+  }
   return 0;
 }
 
@@ -15,6 +15,7 @@ SO_ESCR        define 2
 SO_CRIA_PROC   define 7
 SO_MATA_PROC   define 8
 SO_ESPERA_PROC define 9
+SO_ESCR_STR    define 10
 
 main
          chama impr_inicio
@@ -65,15 +66,24 @@ cada     valor CADA
 ene      valor N
 
 ; imprime a string que inicia em A (destroi X)
+; a string é passada ao SO com SO_ESCR_STR, que aceita um pedaço por vez
 impstr   espaco 1
          trax
 impstr1
          cargx 0
          desvz impstrf
-         chama impch
-         incx
+         cargi SO_ESCR_STR
+         chamas
+         ; A tem quantos caracteres o SO aceitou, ou erro; avança X
+         desvn impstrf
+         desvz impstrf
+         armm impstr_n
+         cpxa
+         soma impstr_n
+         trax
          desv impstr1
 impstrf  ret impstr
+impstr_n espaco 1
 
 ; função que chama o SO para imprimir o caractere em A
 ; retorna em A o código de erro do SO
@@ -0,0 +1,97 @@
+#include "pcache.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct image {
+    char *name;
+    time_t mtime;
+    int disk_init;
+    int n_pages;
+    int size;
+    int load_addr;
+    // quadro com cada página sem alterações, -1 se não está na memória
+    int *frames;
+    image_t *next;
+};
+
+// as imagens não são removidas: o espaço delas na memória secundária não é
+//   reaproveitado, e pode ter processos usando uma imagem de um arquivo que
+//   já mudou
+struct pcache {
+    image_t *head;
+};
+
+pcache_t *pcache_create() {
+    pcache_t *pc = calloc(1, sizeof(pcache_t));
+    assert(pc != NULL);
+    return pc;
+}
+
+void pcache_free(pcache_t *pc) {
+    image_t *img = pc->head;
+    while (img) {
+        image_t *next = img->next;
+        free(img->name);
+        free(img->frames);
+        free(img);
+        img = next;
+    }
+    free(pc);
+}
+
+image_t *pcache_find(pcache_t *pc, char *name, time_t mtime) {
+    for (image_t *img = pc->head; img; img = img->next) {
+        if (img->mtime == mtime && strcmp(img->name, name) == 0) {
+            return img;
+        }
+    }
+    return NULL;
+}
+
+image_t *pcache_insert(pcache_t *pc, char *name, time_t mtime,
+                       int disk_init, int n_pages, int size, int load_addr) {
+    image_t *img = calloc(1, sizeof(image_t));
+    assert(img != NULL);
+
+    img->name = strdup(name);
+    img->mtime = mtime;
+    img->disk_init = disk_init;
+    img->n_pages = n_pages;
+    img->size = size;
+    img->load_addr = load_addr;
+    img->frames = malloc(n_pages * sizeof(int));
+    assert(img->name != NULL && (img->frames != NULL || n_pages == 0));
+    for (int page = 0; page < n_pages; page++) {
+        img->frames[page] = -1;
+    }
+
+    img->next = pc->head;
+    pc->head = img;
+    return img;
+}
+
+int image_disk_init(image_t *img) {
+    return img->disk_init;
+}
+
+int image_n_pages(image_t *img) {
+    return img->n_pages;
+}
+
+int image_size(image_t *img) {
+    return img->size;
+}
+
+int image_load_addr(image_t *img) {
+    return img->load_addr;
+}
+
+int image_frame(image_t *img, int page) {
+    return img->frames[page];
+}
+
+void image_set_frame(image_t *img, int page, int frame) {
+    img->frames[page] = frame;
+}
@@ -0,0 +1,38 @@
+#ifndef PCACHE_H
+#define PCACHE_H
+
+#include <time.h>
+
+// Cache de imagens de programas.
+// A imagem de um programa é colocada na memória secundária uma vez só, e é
+//   usada por todos os processos que executam esse programa: as páginas que
+//   um processo não alterou são lidas da imagem, e as que estão na memória
+//   principal podem ser compartilhadas entre esses processos (ver
+//   image_frame). A chave é o nome do arquivo e a data de modificação dele;
+//   se o arquivo mudar, a carga seguinte cria uma imagem nova.
+
+typedef struct image image_t;
+typedef struct pcache pcache_t;
+
+pcache_t *pcache_create();
+void pcache_free(pcache_t *pc);
+
+// imagem do programa 'name' com data de modificação 'mtime', ou NULL
+image_t *pcache_find(pcache_t *pc, char *name, time_t mtime);
+// registra a imagem de um programa que foi colocada na memória secundária a
+//   partir de 'disk_init', com 'n_pages' páginas; 'size' é o tamanho do
+//   espaço de endereçamento e 'load_addr' o endereço de carga
+image_t *pcache_insert(pcache_t *pc, char *name, time_t mtime,
+                       int disk_init, int n_pages, int size, int load_addr);
+
+int image_disk_init(image_t *img);
+int image_n_pages(image_t *img);
+int image_size(image_t *img);
+int image_load_addr(image_t *img);
+
+// quadro da memória principal que contém a página 'page' da imagem sem
+//   alterações (protegida contra escrita em quem a mapeia), -1 se não tiver
+int image_frame(image_t *img, int page);
+void image_set_frame(image_t *img, int page, int frame);
+
+#endif // PCACHE_H
@@ -7,11 +7,21 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 struct programa_t {
   int carga;
   int tamanho;
-  int *dados;
+  int32_t *dados;
+  // arquivo binário mapeado em memória ('dados' aponta para dentro dele),
+  //   ou NULL se o programa foi lido de um arquivo texto
+  void *mapa;
+  size_t tam_mapa;
 };
 
 // lê os dados do cabeçalho do arquivo (1ª linha)
@@ -29,6 +39,7 @@ static programa_t *pega_cabecalho(char *lin)
   }
   prog->tamanho = tam;
   prog->carga = carga;
+  prog->mapa = NULL;
   return prog;
 }
 
@@ -50,10 +61,58 @@ static void pega_dados(programa_t *self, char *lin)
   }
 }
 
+// mapeia em memória um arquivo no formato binário, já aberto em 'fd'
+// retorna NULL se o arquivo não estiver correto
+static programa_t *prog_cria_binario(int fd)
+{
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size < sizeof(maq_cabecalho_t)) return NULL;
+  void *mapa = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapa == MAP_FAILED) return NULL;
+  maq_cabecalho_t *cab = mapa;
+  size_t tam_dados = (size_t)cab->tamanho * sizeof(int32_t);
+  if (cab->versao != MAQ_VERSAO || cab->tamanho < 0
+      || sizeof(*cab) + tam_dados > st.st_size) {
+    munmap(mapa, st.st_size);
+    return NULL;
+  }
+  programa_t *prog = malloc(sizeof(*prog));
+  if (prog == NULL) {
+    munmap(mapa, st.st_size);
+    return NULL;
+  }
+  prog->tamanho = cab->tamanho;
+  prog->carga = cab->carga;
+  prog->dados = (int32_t *)(cab + 1);
+  prog->mapa = mapa;
+  prog->tam_mapa = st.st_size;
+  return prog;
+}
+
+// retorna true se o arquivo aberto em 'fd' começa com MAQ_MAGICO
+static bool eh_binario(int fd)
+{
+  char magico[4];
+  bool binario = pread(fd, magico, sizeof(magico), 0) == sizeof(magico)
+                 && memcmp(magico, MAQ_MAGICO, sizeof(magico)) == 0;
+  return binario;
+}
+
 programa_t *prog_cria(char *nome)
 {
-  FILE *arq = fopen(nome, "r");
-  if (arq == NULL) return NULL;
+  int fd = open(nome, O_RDONLY);
+  if (fd < 0) return NULL;
+  if (eh_binario(fd)) {
+    programa_t *prog = prog_cria_binario(fd);
+    // o mapeamento continua válido depois de fechar o arquivo
+    close(fd);
+    return prog;
+  }
+  FILE *arq = fdopen(fd, "r");
+  if (arq == NULL) {
+    close(fd);
+    return NULL;
+  }
   char *linha = NULL;
   size_t tam_lin;
   programa_t *prog = NULL;
@@ -71,7 +130,11 @@ fim:
 
 void prog_destroi(programa_t *self)
 {
-  free(self->dados);
+  if (self->mapa != NULL) {
+    munmap(self->mapa, self->tam_mapa);
+  } else {
+    free(self->dados);
+  }
   free(self);
 }
 
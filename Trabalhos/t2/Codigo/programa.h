@@ -6,11 +6,35 @@
 #ifndef PROGRAMA_H
 #define PROGRAMA_H
 
+#include <stdint.h>
+
 // TAD para representar um programa lido de um arquivo '.maq'
+//
+// o arquivo pode estar em formato texto ou binário (gerado com 'montador -b').
+// o formato binário é o cabeçalho abaixo, seguido do conteúdo da memória
+//   ('tamanho' inteiros de 32 bits, a partir do endereço 'carga'), seguido
+//   da tabela de símbolos: para cada um dos 'n_simbolos', o valor e o tamanho
+//   do nome (inteiros de 32 bits) e os caracteres do nome, sem '\0',
+//   completados com zeros até um múltiplo de 4 bytes.
+// os inteiros estão na ordem de bytes da máquina onde o programa foi montado.
+// o conteúdo da memória é usado diretamente do arquivo mapeado em memória,
+//   sem conversão; a tabela de símbolos não é usada pelo simulador.
+
+#define MAQ_MAGICO "MAQB"
+#define MAQ_VERSAO 1
+
+typedef struct {
+  char magico[4];   // MAQ_MAGICO, sem o '\0'
+  int32_t versao;   // MAQ_VERSAO
+  int32_t tamanho;  // número de palavras de memória
+  int32_t carga;    // endereço da primeira palavra
+  int32_t n_simbolos;
+} maq_cabecalho_t;
 
 typedef struct programa_t programa_t;
 
-// cria e inicializa um programa com o conteúdo do arquivo 'nome'
+// cria e inicializa um programa com o conteúdo do arquivo 'nome', em
+//   qualquer dos dois formatos
 // retorna NULL em caso de erro
 programa_t *prog_cria(char *nome);
 
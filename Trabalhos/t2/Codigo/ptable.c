@@ -1,43 +1,184 @@
 #include "ptable.h"
 #include "console.h"
 #include "irq.h"
+#include "mmu.h"
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+// Fila de prontos: um vetor de N_LEVELS níveis de prioridade (quanto menor o
+//   nível, mais prioritário), cada um com uma lista FIFO de processos prontos,
+//   e um mapa de bits com os níveis que não estão vazios. Inserir, remover e
+//   achar o mais prioritário custam O(1), independente do número de processos.
+// Os processos bloqueados ficam em uma lista separada.
+#define N_LEVELS 64
+
 struct process {
     int pid;
-    int PC, A, X, erro, complemento, modo;
+    cpu_contexto_t ctx;
     int quantum;
     float t_exec;
     float prio;
     pstate st;
+    // encadeamento na lista de todos os processos da tabela
+    process_t *prev;
     process_t *next;
     pendency_t pendency;
     // Tabpag
     tabpag_t *tabpag;
+    // região do processo na memória secundária, onde ficam as páginas que ele
+    //   alterou (as marcadas em 'private_pages'); as outras estão na imagem
+    //   do programa
     int init;
     int size;
+    bool *private_pages;
+    image_t *image;
+    // terminal usado pelo processo (-1 se não tem)
+    int terminal;
+    // tabela onde o processo está (NULL se não está em nenhuma)
+    ptable_t *ptbl;
+    // encadeamento na fila de prontos (no nível 'level') ou na de bloqueados
+    int level;
+    process_t *q_prev;
+    process_t *q_next;
+    // processos esperando este terminar (SO_ESPERA_PROC), e o encadeamento
+    //   deste na lista do processo que ele espera
+    process_t *waiters;
+    process_t *waiting_for;
+    process_t *w_prev;
+    process_t *w_next;
+    // fila de E/S em que o processo espera, e o encadeamento nela
+    ioqueue_t *io_queue;
+    process_t *io_prev;
+    process_t *io_next;
+    metrics_t metrics;
+    // relógio da tabela quando o tempo do processo foi contabilizado pela
+    //   última vez (desde então ele está no mesmo estado)
+    int state_since;
 };
 
+typedef struct queue {
+    process_t *head;
+    process_t *tail;
+} queue_t;
+
 struct ptable {
     process_t *running;
     process_t *head;
+    process_t *tail;
+    // processos indexados pelo pid (os pids não se repetem)
+    process_t **by_pid;
+    int cap_pid;
+    queue_t levels[N_LEVELS];
+    uint64_t nonempty_levels;
+    queue_t blocked;
+    int n_ready;
+    // relógio da contabilidade de tempo (avançado por ptable_update_times)
+    int now;
 };
 
+static void queue_append(queue_t *q, process_t *proc) {
+    proc->q_next = NULL;
+    proc->q_prev = q->tail;
+    if (q->tail) {
+        q->tail->q_next = proc;
+    } else {
+        q->head = proc;
+    }
+    q->tail = proc;
+}
+
+static void queue_remove(queue_t *q, process_t *proc) {
+    if (proc->q_prev) {
+        proc->q_prev->q_next = proc->q_next;
+    } else {
+        q->head = proc->q_next;
+    }
+    if (proc->q_next) {
+        proc->q_next->q_prev = proc->q_prev;
+    } else {
+        q->tail = proc->q_prev;
+    }
+    proc->q_prev = NULL;
+    proc->q_next = NULL;
+}
+
+// nível da fila de prontos correspondente à prioridade do processo
+// a prioridade fica normalmente entre 0 e 1; valores fora são saturados
+static int process_level(process_t *proc) {
+    int level = proc->prio * (N_LEVELS - 1);
+    if (level < 0) {
+        return 0;
+    }
+    if (level >= N_LEVELS) {
+        return N_LEVELS - 1;
+    }
+    return level;
+}
+
+// soma ao tempo do processo no estado em que ele está (o processo corrente
+//   conta como running) o que passou desde a última contabilização
+// deve ser chamada antes de qualquer mudança desse estado
+static void process_account(process_t *proc) {
+    ptable_t *ptbl = proc->ptbl;
+    if (!ptbl) {
+        return;
+    }
+    pstate st = proc == ptbl->running ? running : proc->st;
+    proc->metrics.state_time[st] += ptbl->now - proc->state_since;
+    proc->state_since = ptbl->now;
+}
+
+// coloca o processo na fila correspondente ao seu estado
+static void ptable_enqueue(ptable_t *ptbl, process_t *proc) {
+    if (proc->st == blocked) {
+        queue_append(&ptbl->blocked, proc);
+        return;
+    }
+    proc->level = process_level(proc);
+    queue_append(&ptbl->levels[proc->level], proc);
+    ptbl->nonempty_levels |= (uint64_t)1 << proc->level;
+    ptbl->n_ready++;
+}
+
+// retira o processo da fila em que ele está
+static void ptable_dequeue(ptable_t *ptbl, process_t *proc) {
+    if (proc->st == blocked) {
+        queue_remove(&ptbl->blocked, proc);
+        return;
+    }
+    queue_t *q = &ptbl->levels[proc->level];
+    queue_remove(q, proc);
+    if (!q->head) {
+        ptbl->nonempty_levels &= ~((uint64_t)1 << proc->level);
+    }
+    ptbl->n_ready--;
+}
+
+// processo pronto mais prioritário (o primeiro do nível mais baixo)
+static process_t *ptable_first_ready(ptable_t *ptbl) {
+    if (!ptbl->nonempty_levels) {
+        return NULL;
+    }
+    return ptbl->levels[__builtin_ctzll(ptbl->nonempty_levels)].head;
+}
+
 process_t *process_create() {
     process_t *proc = calloc(1, sizeof(process_t));
 
     static int pid = 0;
     proc->pid = pid++;
+    proc->metrics.pid = proc->pid;
 
     proc->quantum = QUANTUM;
     proc->t_exec = 0;
     proc->prio = 0.5;
-    proc->modo = usuario;
+    proc->ctx.modo = usuario;
     proc->st = ready;
+    proc->terminal = -1;
 
     proc->tabpag = tabpag_cria();
 
@@ -45,12 +186,107 @@ process_t *process_create() {
 }
 
 void process_free(process_t *proc) {
+    tabpag_destroi(proc->tabpag);
+    free(proc->private_pages);
     free(proc);
 }
 
+void process_add_waiter(process_t *proc, process_t *waiter) {
+    waiter->waiting_for = proc;
+    waiter->w_prev = NULL;
+    waiter->w_next = proc->waiters;
+    if (proc->waiters) {
+        proc->waiters->w_prev = waiter;
+    }
+    proc->waiters = waiter;
+}
+
+// tira o processo da lista de espera em que ele está, se estiver em uma
+static void process_stop_waiting(process_t *waiter) {
+    process_t *proc = waiter->waiting_for;
+    if (!proc) {
+        return;
+    }
+    if (waiter->w_prev) {
+        waiter->w_prev->w_next = waiter->w_next;
+    } else {
+        proc->waiters = waiter->w_next;
+    }
+    if (waiter->w_next) {
+        waiter->w_next->w_prev = waiter->w_prev;
+    }
+    waiter->waiting_for = NULL;
+    waiter->w_prev = NULL;
+    waiter->w_next = NULL;
+}
+
+void ioqueue_append(ioqueue_t *q, process_t *proc) {
+    ioqueue_remove(proc);
+    proc->io_queue = q;
+    proc->io_prev = q->tail;
+    proc->io_next = NULL;
+    if (q->tail) {
+        q->tail->io_next = proc;
+    } else {
+        q->head = proc;
+    }
+    q->tail = proc;
+}
+
+process_t *ioqueue_head(ioqueue_t *q) {
+    return q->head;
+}
+
+void ioqueue_remove(process_t *proc) {
+    ioqueue_t *q = proc->io_queue;
+    if (!q) {
+        return;
+    }
+    if (proc->io_prev) {
+        proc->io_prev->io_next = proc->io_next;
+    } else {
+        q->head = proc->io_next;
+    }
+    if (proc->io_next) {
+        proc->io_next->io_prev = proc->io_prev;
+    } else {
+        q->tail = proc->io_prev;
+    }
+    proc->io_queue = NULL;
+    proc->io_prev = NULL;
+    proc->io_next = NULL;
+}
+
+void process_wake_waiters(process_t *proc) {
+    while (proc->waiters) {
+        process_t *waiter = proc->waiters;
+        process_stop_waiting(waiter);
+        process_set_state(waiter, ready);
+    }
+}
+
 void process_set_disk(process_t *proc, int init, int size) {
     proc->init = init;
     proc->size = size;
+    free(proc->private_pages);
+    proc->private_pages = calloc((size + TAM_PAGINA - 1) / TAM_PAGINA + 1, sizeof(bool));
+    assert(proc->private_pages != NULL);
+}
+
+bool process_page_private(process_t *proc, int page) {
+    return proc->private_pages[page];
+}
+
+void process_set_page_private(process_t *proc, int page) {
+    proc->private_pages[page] = true;
+}
+
+void process_set_image(process_t *proc, image_t *img) {
+    proc->image = img;
+}
+
+image_t *process_image(process_t *proc) {
+    return proc->image;
 }
 
 int process_disk_init(process_t *proc) {
@@ -62,25 +298,19 @@ int process_disk_size(process_t *proc) {
 }
 
 int process_complemento(process_t *proc) {
-    return proc->complemento;
+    return proc->ctx.complemento;
 }
 
-void process_save_registers(process_t *proc, mem_t *mem) {
-    mem_le(mem, IRQ_END_PC, &proc->PC);
-    mem_le(mem, IRQ_END_A, &proc->A);
-    mem_le(mem, IRQ_END_X, &proc->X);
-    mem_le(mem, IRQ_END_erro, &proc->erro);
-    mem_le(mem, IRQ_END_complemento, &proc->complemento);
-    mem_le(mem, IRQ_END_modo, &proc->modo);
+metrics_t *process_metrics(process_t *proc) {
+    return &proc->metrics;
 }
 
-void process_load_registers(process_t *proc, mem_t *mem) {
-    mem_escreve(mem, IRQ_END_PC, proc->PC);
-    mem_escreve(mem, IRQ_END_A, proc->A);
-    mem_escreve(mem, IRQ_END_X, proc->X);
-    mem_escreve(mem, IRQ_END_erro, proc->erro);
-    mem_escreve(mem, IRQ_END_complemento, proc->complemento);
-    mem_escreve(mem, IRQ_END_modo, proc->modo);
+void process_save_registers(process_t *proc, cpu_t *cpu) {
+    cpu_salva_contexto(cpu, &proc->ctx);
+}
+
+void process_load_registers(process_t *proc, cpu_t *cpu) {
+    cpu_carrega_contexto(cpu, &proc->ctx);
 }
 
 void process_printf(process_t *proc) {
@@ -92,12 +322,12 @@ void process_printf(process_t *proc) {
 
     printf("PID: %u\n", proc->pid);
     printf("PC: %d\nA: %d\nX: %d\nerro: %d\ncomplemento: %d\nmodo: %d\n",
-           proc->PC,
-           proc->A,
-           proc->X,
-           proc->erro,
-           proc->complemento,
-           proc->modo);
+           proc->ctx.PC,
+           proc->ctx.A,
+           proc->ctx.X,
+           proc->ctx.erro,
+           proc->ctx.complemento,
+           proc->ctx.modo);
     printf("%s\n", proc->st ? "ready" : "blocked");
     printf("%p\n", proc->next);
 }
@@ -111,16 +341,25 @@ tabpag_t *process_tabpag(process_t *proc) {
 }
 
 void process_set_state(process_t *proc, pstate st) {
+    process_account(proc);
+    // só muda de fila se mudar de estado
+    bool requeue = proc->ptbl && proc->st != st;
+    if (requeue) {
+        ptable_dequeue(proc->ptbl, proc);
+    }
     proc->st = st;
     if (st == blocked) {
         // prio = (prio + t_exec/t_quantum) / 2
         proc->prio = (proc->prio + proc->t_exec / QUANTUM) / 2;
     }
-    logs.number_states_process[proc->pid][st]++;
+    if (requeue) {
+        ptable_enqueue(proc->ptbl, proc);
+    }
+    proc->metrics.states[st]++;
 }
 
 cpu_modo_t process_modo(process_t *proc) {
-    return proc->modo;
+    return proc->ctx.modo;
 }
 
 process_t *ptable_running_process(ptable_t *ptbl) {
@@ -131,40 +370,60 @@ process_t *ptable_head(ptable_t *ptbl) {
     return ptbl->head;
 }
 
+int process_terminal(process_t *proc) {
+    return proc->terminal;
+}
+
+void process_set_terminal(process_t *proc, int terminal) {
+    proc->terminal = terminal;
+}
+
 int process_pid(process_t *proc) {
     return proc->pid;
 }
 
 int process_PC(process_t *proc) {
-    return proc->PC;
+    return proc->ctx.PC;
 }
 
 int process_X(process_t *proc) {
-    return proc->X;
+    return proc->ctx.X;
 }
 
 int process_A(process_t *proc) {
-    return proc->A;
+    return proc->ctx.A;
 }
 
 process_t *process_next(process_t *proc) {
     return proc->next;
 }
 
+process_t *ptable_first_blocked(ptable_t *ptbl) {
+    return ptbl->blocked.head;
+}
+
+process_t *process_next_blocked(process_t *proc) {
+    return proc->q_next;
+}
+
 pendency_t process_pendency(process_t *proc) {
     return proc->pendency;
 }
 
 void process_set_PC(process_t *proc, int PC) {
-    proc->PC = PC;
+    proc->ctx.PC = PC;
 }
 
 void process_set_A(process_t *proc, int A) {
-    proc->A = A;
+    proc->ctx.A = A;
+}
+
+void process_set_erro(process_t *proc, int erro) {
+    proc->ctx.erro = erro;
 }
 
 void process_set_modo(process_t *proc, cpu_modo_t modo) {
-    proc->modo = modo;
+    proc->ctx.modo = modo;
 }
 
 void process_set_pendency(process_t *proc, pendency_t pendency) {
@@ -197,6 +456,7 @@ void ptable_free(ptable_t *ptbl) {
         curr = next;
     }
 
+    free(ptbl->by_pid);
     free(ptbl);
 }
 
@@ -221,94 +481,95 @@ void ptable_printf(ptable_t *ptbl) {
 }
 
 void ptable_set_running_process(ptable_t *ptbl, process_t *proc) {
+    if (ptbl->running) {
+        process_account(ptbl->running);
+    }
     if (proc) {
+        process_account(proc);
         proc->quantum = QUANTUM;
         proc->t_exec = 0;
-        logs.number_states_process[proc->pid][running]++;
+        proc->metrics.states[running]++;
     }
 
     ptbl->running = proc;
 }
 
 void ptable_insert_process(ptable_t *ptbl, process_t *proc) {
-    process_t *curr = ptbl->head;
 
-    while (curr && curr->next) {
-        curr = curr->next;
+    if (proc->pid >= ptbl->cap_pid) {
+        int cap = ptbl->cap_pid ? ptbl->cap_pid : 16;
+        while (proc->pid >= cap) {
+            cap *= 2;
+        }
+        ptbl->by_pid = realloc(ptbl->by_pid, cap * sizeof(process_t *));
+        assert(ptbl->by_pid != NULL);
+        for (int i = ptbl->cap_pid; i < cap; i++) {
+            ptbl->by_pid[i] = NULL;
+        }
+        ptbl->cap_pid = cap;
     }
+    ptbl->by_pid[proc->pid] = proc;
 
-    if (curr) {
-        curr->next = proc;
+    proc->prev = ptbl->tail;
+    proc->next = NULL;
+    if (ptbl->tail) {
+        ptbl->tail->next = proc;
     } else {
         ptbl->head = proc;
     }
+    ptbl->tail = proc;
 
-    proc->next = NULL;
+    proc->ptbl = ptbl;
+    proc->state_since = ptbl->now;
+    ptable_enqueue(ptbl, proc);
 }
 
 void ptable_remove_process(ptable_t *ptbl, process_t *proc) {
-    process_t *prev = NULL;
-    process_t *curr = ptbl->head;
 
-    while (curr != proc) {
-        prev = curr;
-        curr = curr->next;
-    }
-
-    if (!curr) {
+    if (proc->ptbl != ptbl) {
         return;
     }
 
-    if (prev) {
-        prev->next = curr->next;
+    // fora da tabela o tempo não conta mais
+    process_account(proc);
+
+    if (proc->prev) {
+        proc->prev->next = proc->next;
     } else {
-        ptbl->head = curr->next;
+        ptbl->head = proc->next;
+    }
+    if (proc == ptbl->running) {
         ptable_set_running_process(ptbl, NULL);
     }
+    if (proc->next) {
+        proc->next->prev = proc->prev;
+    } else {
+        ptbl->tail = proc->prev;
+    }
 
+    proc->prev = NULL;
     proc->next = NULL;
-}
 
-process_t *ptable_find(ptable_t *ptbl, int pid) {
-    process_t *curr = ptbl->head;
+    ptbl->by_pid[proc->pid] = NULL;
 
-    while (curr && curr->pid != pid) {
-        curr = curr->next;
-    }
+    // um processo que morre não espera mais ninguém, nem por E/S
+    process_stop_waiting(proc);
+    ioqueue_remove(proc);
 
-    return curr;
+    ptable_dequeue(ptbl, proc);
+    proc->ptbl = NULL;
 }
 
-// :|
-void ptable_check_waiting(ptable_t *ptbl) {
-
-    process_t *curr = ptbl->head;
-
-    while (curr) {
-        if (curr->st == blocked && curr->A == 9 &&
-            !ptable_find(ptbl, curr->X)) {
-            curr->st = ready;
-        }
-
-        curr = curr->next;
+process_t *ptable_find(ptable_t *ptbl, int pid) {
+    if (pid < 0 || pid >= ptbl->cap_pid) {
+        return NULL;
     }
+    return ptbl->by_pid[pid];
 }
 
-void ptable_standard_mode(ptable_t *ptbl, bool mode) {
-
-    process_t *prev = NULL;
-    process_t *curr = ptbl->head;
+void ptable_standard_mode(ptable_t *ptbl) {
 
-    while (curr && curr->st != ready) {
-        prev = curr;
-        curr = curr->next;
-    }
-
-    if (prev && curr && !mode) {
-        prev->next = curr->next;
-        curr->next = ptbl->head;
-        ptbl->head = curr;
-    }
+    process_t *curr = ptable_first_ready(ptbl);
 
     if (ptbl->running && ptbl->running == curr && ptbl->running->quantum == 0) {
         ptbl->running->quantum = QUANTUM;
@@ -319,23 +580,18 @@ void ptable_standard_mode(ptable_t *ptbl, bool mode) {
     }
 }
 
+// coloca o processo em execução no fim da fila do seu nível, atrás dos
+//   outros processos com a mesma prioridade
 void ptable_move_to_end(ptable_t *ptbl) {
 
-    process_t *curr = ptbl->head;
-    process_t *last = ptbl->head;
+    process_t *curr = ptbl->running;
 
-    if (!curr || !curr->next) {
+    if (!curr || curr->st != ready) {
         return;
     }
 
-    while (last->next) {
-        last = last->next;
-    }
-
-    ptbl->head = curr->next;
-
-    last->next = curr;
-    curr->next = NULL;
+    ptable_dequeue(ptbl, curr);
+    ptable_enqueue(ptbl, curr);
 }
 
 void ptable_preemptive_mode(ptable_t *ptbl) {
@@ -348,7 +604,7 @@ void ptable_preemptive_mode(ptable_t *ptbl) {
 
     if (curr && curr->quantum == 0) {
         logs.number_preemptions++;
-        logs.number_preemptions_process[curr->pid]++;
+        curr->metrics.preemptions++;
 
         ptable_move_to_end(ptbl);
     }
@@ -364,52 +620,6 @@ void ptable_preemptive_mode(ptable_t *ptbl) {
     // console_printf("----------------");
 }
 
-static process_t *ptable_minimum_prio(ptable_t *ptbl) {
-
-    if (!ptbl->head) {
-        return NULL;
-    }
-
-    process_t *prev = NULL;
-    process_t *curr = ptbl->head;
-
-    process_t *minprev = NULL;
-    process_t *minimum = ptbl->head;
-
-    while (curr) {
-        if (curr->prio < minimum->prio) {
-            minprev = prev;
-            minimum = curr;
-        }
-
-        prev = curr;
-        curr = curr->next;
-    }
-
-    if (minprev) {
-        minprev->next = minimum->next;
-    } else {
-        ptbl->head = minimum->next;
-    }
-
-    minimum->next = NULL;
-
-    return minimum;
-}
-
-void ptable_sort_by_priority(ptable_t *ptbl) {
-
-    process_t *head = ptable_minimum_prio(ptbl);
-    process_t *curr = head;
-
-    while (curr) {
-        curr->next = ptable_minimum_prio(ptbl);
-        curr = curr->next;
-    }
-
-    ptbl->head = head;
-}
-
 void ptable_priority_mode(ptable_t *ptbl) {
 
     process_t *curr = ptbl->running;
@@ -420,13 +630,15 @@ void ptable_priority_mode(ptable_t *ptbl) {
 
     if (curr && curr->quantum == 0) {
         logs.number_preemptions++;
-        logs.number_preemptions_process[curr->pid]++;
+        curr->metrics.preemptions++;
 
         // prio = (prio + t_exec/t_quantum) / 2
         curr->prio = (curr->prio + curr->t_exec / QUANTUM) / 2.0;
-    }
 
-    ptable_sort_by_priority(ptbl);
+        // muda de nível conforme a nova prioridade, e vai para o fim da fila
+        //   desse nível
+        ptable_move_to_end(ptbl);
+    }
 
     // curr = ptbl->head;
     // while (curr) {
@@ -441,29 +653,9 @@ void ptable_priority_mode(ptable_t *ptbl) {
 }
 
 bool ptable_idle(ptable_t *ptbl) {
-
-    process_t *curr = ptbl->head;
-
-    while (curr) {
-        if (curr->st != blocked) {
-            return false;
-        }
-        curr = curr->next;
-    }
-
-    return true;
+    return ptbl->n_ready == 0;
 }
 
-void ptable_update_times(ptable_t *ptbl) {
-
-    process_t *curr = ptbl->head;
-
-    while (curr) {
-        if (curr == ptbl->running) {
-            logs.process_state_time[curr->pid][2]++;
-        } else {
-            logs.process_state_time[curr->pid][curr->st]++;
-        }
-        curr = curr->next;
-    }
+void ptable_update_times(ptable_t *ptbl, int n) {
+    ptbl->now += n;
 }
@@ -4,11 +4,12 @@
 #include "cpu.h"
 #include "err.h"
 #include "memoria.h"
+#include "pcache.h"
 #include <stdio.h>
 
 #define QUANTUM 5
 
-typedef enum pendency { none, read, write } pendency_t;
+typedef enum pendency { none, read, write, write_str, paging } pendency_t;
 
 typedef enum pstate { blocked, ready, running } pstate;
 
@@ -16,27 +17,39 @@ typedef struct process process_t;
 typedef struct ptable ptable_t;
 typedef struct log log_t;
 
+typedef struct metrics metrics_t;
+
+// fila de processos esperando um dispositivo de E/S, em ordem de chegada
+typedef struct ioqueue {
+    process_t *head;
+    process_t *tail;
+} ioqueue_t;
+
+// contadores globais do sistema
 struct log {
     int process_created;
     int total_time;
     int time_blocked;
 
-    int number_interruptions[5]; // so_le, so_escr, so_cria_proc, so_mata_proc,
-                                 // so_espera_proc
+    int number_interruptions[6]; // so_le, so_escr, so_cria_proc, so_mata_proc,
+                                 // so_espera_proc, so_escr_str
     int number_preemptions;
+};
 
-    int process_created_at[4];
-    int process_killed_at[4];
-
-    int process_time[4]; // init, p1, p2, p3
-
-    int number_preemptions_process[4]; // p1, p2, p3
+// métricas de um processo, mantidas junto com ele
+struct metrics {
+    int pid;
+    int created_at;
+    int killed_at;
 
-    int number_states_process[4][3]; // p1, p2, p3 x ready, blocked, running
+    int preemptions;
 
-    int process_state_time[4][3]; // p1, p2, p3 x ready, blocked, running
+    int states[3];     // vezes que entrou em cada estado (blocked, ready, running)
+    int state_time[3]; // tempo em cada estado (blocked, ready, running)
 
-    int mean_time[4]; // init, p1, p2, p3
+    int page_faults;
+    int clean_drops;      // páginas retiradas da memória sem cópia (limpas)
+    int dirty_writebacks; // páginas copiadas para o disco (alteradas)
 };
 
 extern log_t logs;
@@ -44,8 +57,21 @@ extern log_t logs;
 process_t *process_create();
 void process_free(process_t *proc);
 
-void process_save_registers(process_t *proc, mem_t *mem);
-void process_load_registers(process_t *proc, mem_t *mem);
+// registra que 'waiter' espera o término de 'proc'
+void process_add_waiter(process_t *proc, process_t *waiter);
+// desbloqueia os processos que esperam o término de 'proc'
+void process_wake_waiters(process_t *proc);
+
+// coloca 'proc' no fim da fila 'q' (um processo está em no máximo uma fila)
+void ioqueue_append(ioqueue_t *q, process_t *proc);
+process_t *ioqueue_head(ioqueue_t *q);
+// tira o processo da fila de E/S em que ele está, se estiver em uma
+void ioqueue_remove(process_t *proc);
+
+// copia o contexto salvo pela CPU na interrupção para o processo, e o do
+//   processo para a CPU, para ser recuperado no retorno da interrupção
+void process_save_registers(process_t *proc, cpu_t *cpu);
+void process_load_registers(process_t *proc, cpu_t *cpu);
 
 void process_printf(process_t *proc);
 pstate process_state(process_t *proc);
@@ -55,23 +81,41 @@ tabpag_t *process_tabpag(process_t *proc);
 process_t *ptable_running_process(ptable_t *ptbl);
 process_t *ptable_head(ptable_t *ptbl);
 
+// região própria do processo na memória secundária, com 'size' palavras;
+//   só as páginas privadas (que o processo alterou) são guardadas nela
 void process_set_disk(process_t *proc, int init, int size);
 int process_disk_init(process_t *proc);
 int process_disk_size(process_t *proc);
+bool process_page_private(process_t *proc, int page);
+void process_set_page_private(process_t *proc, int page);
+// imagem do programa que o processo executa, de onde vêm as páginas que não
+//   são privadas
+void process_set_image(process_t *proc, image_t *img);
+image_t *process_image(process_t *proc);
 
 int process_complemento(process_t *proc);
 
+metrics_t *process_metrics(process_t *proc);
+
 int process_pid(process_t *proc);
+// terminal do processo, -1 se não tiver
+int process_terminal(process_t *proc);
+void process_set_terminal(process_t *proc, int terminal);
 int process_PC(process_t *proc);
 int process_X(process_t *proc);
 int process_A(process_t *proc);
 cpu_modo_t process_modo(process_t *proc);
 
 process_t *process_next(process_t *proc);
+
+// percorre só os processos bloqueados
+process_t *ptable_first_blocked(ptable_t *ptbl);
+process_t *process_next_blocked(process_t *proc);
 pendency_t process_pendency(process_t *proc);
 
 void process_set_PC(process_t *proc, int PC);
 void process_set_A(process_t *proc, int A);
+void process_set_erro(process_t *proc, int erro);
 void process_set_pendency(process_t *proc, pendency_t pendency);
 void process_set_modo(process_t *proc, cpu_modo_t modo);
 void process_dec_quantum(process_t *proc);
@@ -90,15 +134,17 @@ void ptable_insert_process(ptable_t *ptbl, process_t *proc);
 void ptable_remove_process(ptable_t *ptbl, process_t *proc);
 
 process_t *ptable_find(ptable_t *ptbl, int pid);
-void ptable_check_waiting(ptable_t *ptbl);
 
 void ptable_move_to_end(ptable_t *ptbl);
 
-void ptable_standard_mode(ptable_t *ptbl, bool mode);
+// escolhe para executar o processo pronto mais prioritário
+void ptable_standard_mode(ptable_t *ptbl);
 void ptable_preemptive_mode(ptable_t *ptbl);
 void ptable_priority_mode(ptable_t *ptbl);
-void ptable_sort_by_priority(ptable_t *ptbl);
 bool ptable_idle(ptable_t *ptbl);
-void ptable_update_times(ptable_t *ptbl);
+// avança 'n' unidades o relógio da contabilidade de tempo; o tempo de cada
+//   processo em um estado é somado às métricas quando ele sai do estado
+//   (ou da tabela), não a cada chamada
+void ptable_update_times(ptable_t *ptbl, int n);
 
 #endif // PTABLE_H
@@ -7,18 +7,25 @@
 #include "so.h"
 #include "dispositivos.h"
 #include "irq.h"
+#include "ftable.h"
+#include "pcache.h"
 #include "programa.h"
 #include "ptable.h"
+#include "swap.h"
 #include "tabpag.h"
-#include "ulist.h"
 
 #include <assert.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 
 // CONSTANTES E TIPOS {{{1
 // intervalo entre interrupções do relógio
 #define INTERVALO_INTERRUPCAO 50 // em instruções executadas
+// tempo de transferência de uma página entre a memória principal e a secundária
+#define TEMPO_TROCA_PAGINA 10 // em instruções executadas
+// tamanho do buffer de saída de cada terminal, em caracteres
+#define TAM_BUF_SAIDA 64
 
 // Não tem processos nem memória virtual, mas é preciso usar a paginação,
 //   pelo menos para implementar relocação, já que os programas estão sendo
@@ -39,13 +46,24 @@
 //   representar a inexistência de um processo, coloquei -1. Altere para o seu
 //   tipo, ou substitua os usos de processo_t e NENHUM_PROCESSO para o seu tipo.
 
-#define DISK_TAM 1000
+// a memória secundária é mantida em um arquivo esparso, mapeado em memória
+#define DISK_TAM 4000000
+#define DISK_ARQUIVO "disco.bin"
 typedef mem_t disk_t;
 int pos_livre = 0;
 
 
 log_t logs;
 
+// buffer circular com os caracteres escritos por um processo que ainda não
+//   foram enviados ao seu terminal; fica no SO porque o processo pode morrer
+//   antes de a saída terminar
+typedef struct {
+    int dados[TAM_BUF_SAIDA];
+    int inicio;
+    int n;
+} buf_saida_t;
+
 struct so_t {
     cpu_t *cpu;
     mem_t *mem;
@@ -56,18 +74,52 @@ struct so_t {
 
     // t1: tabela de processos, processo corrente, pendências, etc
     ptable_t *ptbl;
-    wlist_t *wlst;
     log_t *log;
     bool finished;
-
-    // primeiro quadro da memória que está livre (quadros anteriores estão ocupados)
-    // t2: com memória virtual, o controle de memória livre e ocupada é mais
-    //     completo que isso
-    int quadro_livre;
-    // uma tabela de páginas para poder usar a MMU
-    // t2: com processos, não tem esta tabela global, tem que ter uma para
-    //     cada processo
+    // interrupções tratadas pelo caminho rápido desde a última contabilizada
+    //   (ver so_trata_interrupcao)
+    int n_adiadas;
+
+    // tabela de quadros da memória principal, com a política de substituição
+    ftable_t *ftbl;
+    int n_page_faults;
+    int n_evictions;
+    int n_clean_drops;
+    int n_dirty_writebacks;
+    // faltas atendidas com um quadro que já tinha a página (compartilhada), e
+    //   páginas compartilhadas copiadas porque um processo escreveu nelas
+    int n_shared_pages;
+    int n_cow_copies;
+    // processo que tem fixados os quadros da instrução que causou uma falta,
+    //   e o PC dessa instrução (ver so_fixa_quadros)
+    process_t *fixado;
+    int pc_fixado;
+    // processos bloqueados porque não tinha quadro para a falta deles,
+    //   acordados quando algum quadro pode ter sido liberado, e se o processo
+    //   com quadros fixados é um deles
+    ioqueue_t espera_quadro;
+    bool fixado_espera;
+
+    // métricas dos processos que já terminaram
+    metrics_t *finished_metrics;
+    int n_finished;
+    int cap_finished;
+    // memória secundária, com o dispositivo que controla as transferências
+    swap_t *swap;
     disk_t *disk;
+    // imagens dos programas já carregados na memória secundária
+    pcache_t *pcache;
+
+    // terminais, distribuídos aos processos na criação; 'dono_terminal' tem o
+    //   processo que usa cada terminal (NULL se o terminal está livre)
+    int n_terminais;
+    process_t **dono_terminal;
+    // processos bloqueados esperando cada terminal, atendidos quando o
+    //   terminal interrompe
+    ioqueue_t *espera_teclado;
+    ioqueue_t *espera_tela;
+    // saída buferizada de cada terminal
+    buf_saida_t *saida;
 
     FILE *prints;
 };
@@ -98,10 +150,13 @@ so_t *so_cria(cpu_t *cpu, mem_t *mem, mmu_t *mmu, es_t *es, console_t *console)
     // quando a CPU executar uma instrução CHAMAC, deve chamar a função
     //   so_trata_interrupcao, com primeiro argumento um ptr para o SO
     cpu_define_chamaC(self->cpu, so_trata_interrupcao, self);
+    // o estado dos processos é trocado direto com o banco de registradores
+    //   da CPU, sem passar pela memória
+    cpu_define_contexto_na_memoria(self->cpu, false);
 
     // coloca o tratador de interrupção na memória
     // quando a CPU aceita uma interrupção, passa para modo supervisor,
-    //   salva seu estado à partir do endereço 0, e desvia para o endereço
+    //   salva seu estado (ver cpu_salva_contexto), e desvia para o endereço
     //   IRQ_END_TRATADOR
     // colocamos no endereço IRQ_END_TRATADOR o programa de tratamento
     //   de interrupção (escrito em asm). esse programa deve conter a
@@ -119,13 +174,15 @@ so_t *so_cria(cpu_t *cpu, mem_t *mem, mmu_t *mmu, es_t *es, console_t *console)
         self->erro_interno = true;
     }
 
-    self->disk = mem_cria(DISK_TAM);
+    self->swap = swap_create(DISK_TAM, DISK_ARQUIVO, TEMPO_TROCA_PAGINA);
+    self->disk = swap_disk(self->swap);
+    self->pcache = pcache_create();
 
     // t1
     self->ptbl = ptable_create();
-    self->wlst = wlist_alloc();
 
     self->finished = false;
+    self->n_adiadas = 0;
 
     self->prints = fopen("vetores.txt", "w");
 
@@ -135,16 +192,63 @@ so_t *so_cria(cpu_t *cpu, mem_t *mem, mmu_t *mmu, es_t *es, console_t *console)
     // self->tabpag_global = tabpag_cria();
     // mmu_define_tabpag(self->mmu, self->tabpag_global);
     // define o primeiro quadro livre de memória como o seguinte àquele que
-    //   contém o endereço 99 (as 100 primeiras posições de memória (pelo menos)
-    //   não vão ser usadas por programas de usuário)
-    // t2: o controle de memória livre deve ser mais aprimorado que isso
-    self->quadro_livre = 99 / TAM_PAGINA + 1;
+    //   contém o último endereço da área reservada (as SO_MEM_RESERVADA
+    //   primeiras posições de memória (pelo menos) não vão ser usadas por
+    //   programas de usuário)
+    int primeiro_quadro = (SO_MEM_RESERVADA - 1) / TAM_PAGINA + 1;
+    self->ftbl = ftable_create(mem_tam(self->mem) / TAM_PAGINA, primeiro_quadro, pol_fifo);
+    self->n_page_faults = 0;
+    self->n_evictions = 0;
+    self->n_clean_drops = 0;
+    self->n_dirty_writebacks = 0;
+    self->n_shared_pages = 0;
+    self->n_cow_copies = 0;
+    self->fixado = NULL;
+    self->espera_quadro = (ioqueue_t){ NULL, NULL };
+    self->fixado_espera = false;
+    self->finished_metrics = NULL;
+    self->n_terminais = console_n_terminais(console);
+    self->dono_terminal = calloc(self->n_terminais, sizeof(*self->dono_terminal));
+    self->espera_teclado = calloc(self->n_terminais, sizeof(*self->espera_teclado));
+    self->espera_tela = calloc(self->n_terminais, sizeof(*self->espera_tela));
+    self->saida = calloc(self->n_terminais, sizeof(*self->saida));
+    assert(self->dono_terminal != NULL && self->espera_teclado != NULL
+           && self->espera_tela != NULL && self->saida != NULL);
+    for (int t = 0; t < self->n_terminais; t++) {
+        self->espera_teclado[t] = (ioqueue_t){ NULL, NULL };
+        self->espera_tela[t] = (ioqueue_t){ NULL, NULL };
+        self->saida[t].inicio = 0;
+        self->saida[t].n = 0;
+    }
+    self->n_finished = 0;
+    self->cap_finished = 0;
     return self;
 }
 
+void so_define_tempo_de_troca(so_t *self, int tempo) {
+    swap_set_page_time(self->swap, tempo);
+}
+
+bool so_define_politica_de_substituicao(so_t *self, char *nome) {
+    policy_t policy;
+    if (!ftable_policy_by_name(nome, &policy)) {
+        return false;
+    }
+    ftable_set_policy(self->ftbl, policy);
+    return true;
+}
+
 void so_destroi(so_t *self) {
     cpu_define_chamaC(self->cpu, NULL, NULL);
     ptable_free(self->ptbl);
+    ftable_free(self->ftbl);
+    swap_free(self->swap);
+    pcache_free(self->pcache);
+    free(self->finished_metrics);
+    free(self->dono_terminal);
+    free(self->espera_teclado);
+    free(self->espera_tela);
+    free(self->saida);
     fclose(self->prints);
     free(self);
 }
@@ -157,6 +261,13 @@ static void so_trata_irq(so_t *self, int irq);
 static void so_trata_pendencias(so_t *self);
 static void so_escalona(so_t *self);
 static int so_despacha(so_t *self);
+static void so_trata_irq_chamada_sistema(so_t *self);
+static bool so_chamada_de_es(so_t *self, irq_t irq);
+static bool so_pode_voltar_direto(so_t *self);
+static int so_volta_direto(so_t *self);
+static void so_contabiliza_adiadas(so_t *self);
+static void so_verifica_quadros_fixados(so_t *self);
+static void so_acorda_espera_quadro(so_t *self);
 
 // função a ser chamada pela CPU quando executa a instrução CHAMAC, no tratador de
 //   interrupção em assembly
@@ -177,8 +288,28 @@ static int so_trata_interrupcao(void *argC, int reg_A) {
     irq_t irq = reg_A;
 
     so_salva_estado_da_cpu(self);
+    so_verifica_quadros_fixados(self);
 
-    so_trata_irq(self, irq);
+    // caminho rápido: uma chamada de E/S atendida na hora, que deixa o
+    //   processo pronto, não muda nada para o escalonador; volta direto para
+    //   o processo, e a contabilidade fica para a próxima interrupção
+    bool tratada = false;
+    if (so_chamada_de_es(self, irq)) {
+        so_trata_irq_chamada_sistema(self);
+        if (so_pode_voltar_direto(self)) {
+            self->n_adiadas++;
+            return so_volta_direto(self);
+        }
+        tratada = true;
+    }
+
+    // as interrupções adiadas são contabilizadas com os estados de antes
+    //   desta mudar alguma coisa
+    so_contabiliza_adiadas(self);
+
+    if (!tratada) {
+        so_trata_irq(self, irq);
+    }
 
     so_trata_pendencias(self);
 
@@ -191,87 +322,181 @@ static void so_salva_estado_da_cpu(so_t *self) {
     process_t *running = ptable_running_process(self->ptbl);
 
     if (running) {
-        process_save_registers(running, self->mem);
+        process_save_registers(running, self->cpu);
     }
 }
 
-void so_resolve_read(so_t *self, process_t *proc) {
-
-    dispositivo_id_t check_disp = process_pid(proc) * 4 + D_TERM_A_TECLADO_OK;
-    dispositivo_id_t access_disp = process_pid(proc) * 4 + D_TERM_A_TECLADO;
+// tenta atender a leitura pendente de 'proc'; retorna true se conseguiu
+static bool so_resolve_read(so_t *self, process_t *proc) {
 
-    int available;
+    // o teclado responde ERR_OCUP se não tiver dado, não precisa consultar
+    //   o estado antes
+    int t = process_terminal(proc);
+    dispositivo_id_t access_disp = D_TERMINAL(t, D_TERM_A_TECLADO);
 
-    if (es_le(self->es, check_disp, &available) != ERR_OK) {
-        self->erro_interno = true;
-        return;
-    }
+    int data;
+    err_t err = es_le(self->es, access_disp, &data);
 
-    if (!available) {
-        return;
+    if (err == ERR_OCUP) {
+        return false;
     }
-
-    int data;
-    if (es_le(self->es, access_disp, &data) != ERR_OK) {
+    if (err != ERR_OK) {
         self->erro_interno = true;
-        return;
+        return false;
     }
 
     process_set_A(proc, data);
 
     process_set_pendency(proc, none);
     process_set_state(proc, ready);
+    return true;
 }
 
-void so_resolve_write(so_t *self, process_t *proc) {
+static bool so_le_mem_do_processo(so_t *self, process_t *proc, int end_virt, int *pvalor);
 
-    dispositivo_id_t check_disp = process_pid(proc) * 4 + D_TERM_A_TELA_OK;
-    dispositivo_id_t access_disp = process_pid(proc) * 4 + D_TERM_A_TELA;
+// se o valor pode ser enviado a um terminal, um byte; o montador coloca as
+//   strings na memória como char, com sinal, e os bytes acima de 127 (de
+//   caracteres UTF-8) ficam negativos
+static bool so_eh_caractere(int valor) {
+    return valor >= -128 && valor <= 255;
+}
 
-    int available;
+// coloca no buffer de saída do terminal de 'proc' o que ele pediu para escrever
+//   (o caractere em X ou a string no endereço em X), e o resultado em A
+// retorna false se o buffer estiver cheio
+static bool so_bufferiza_saida(so_t *self, process_t *proc, pendency_t pendency) {
+    buf_saida_t *buf = &self->saida[process_terminal(proc)];
 
-    if (es_le(self->es, check_disp, &available) != ERR_OK) {
-        self->erro_interno = true;
-        return;
+    if (pendency == write && !so_eh_caractere(process_X(proc))) {
+        process_set_A(proc, -1);
+        return true;
     }
 
-    if (!available) {
-        return;
+    if (buf->n == TAM_BUF_SAIDA) {
+        return false;
     }
 
-    int data = process_X(proc);
+    if (pendency == write) {
+        buf->dados[(buf->inicio + buf->n++) % TAM_BUF_SAIDA] = process_X(proc);
+        process_set_A(proc, 0);
+        return true;
+    }
 
-    if (es_escreve(self->es, access_disp, data) != ERR_OK) {
-        self->erro_interno = true;
-        return;
+    // a string vai até o valor 0 ou até encher o buffer; um endereço
+    //   inválido ou um valor que não é caractere também terminam a string,
+    //   e são erro se estiverem no início dela (senão, o erro fica para a
+    //   próxima chamada, que começa neles)
+    int end_virt = process_X(proc);
+    int n = 0;
+    while (buf->n < TAM_BUF_SAIDA) {
+        int caractere;
+        if (!so_le_mem_do_processo(self, proc, end_virt + n, &caractere)
+            || !so_eh_caractere(caractere)) {
+            if (n == 0) {
+                process_set_A(proc, -1);
+                return true;
+            }
+            break;
+        }
+        if (caractere == 0) {
+            break;
+        }
+        buf->dados[(buf->inicio + buf->n++) % TAM_BUF_SAIDA] = caractere;
+        n++;
     }
+    process_set_A(proc, n);
+    return true;
+}
 
-    process_set_A(proc, 0);
+// tenta atender a escrita pendente de 'proc'; retorna true se conseguiu
+static bool so_resolve_write(so_t *self, process_t *proc) {
+    if (!so_bufferiza_saida(self, proc, process_pendency(proc))) {
+        return false;
+    }
 
     process_set_pendency(proc, none);
     process_set_state(proc, ready);
+    return true;
 }
 
-static void so_trata_pendencias(so_t *self) {
-
-    process_t *curr = ptable_head(self->ptbl);
+// envia ao terminal 't' o que tiver no buffer de saída, enquanto a tela aceitar
+static void so_esvazia_saida(so_t *self, int t) {
+    buf_saida_t *buf = &self->saida[t];
+    dispositivo_id_t access_disp = D_TERMINAL(t, D_TERM_A_TELA);
 
-    while (curr) {
+    // a tela responde ERR_OCUP enquanto não aceita mais caracteres
+    while (buf->n > 0) {
+        err_t err = es_escreve(self->es, access_disp, buf->dados[buf->inicio]);
+        if (err == ERR_OCUP) {
+            return;
+        }
+        if (err != ERR_OK) {
+            self->erro_interno = true;
+            return;
+        }
+        buf->inicio = (buf->inicio + 1) % TAM_BUF_SAIDA;
+        buf->n--;
+    }
+}
 
-        pendency_t pendency = process_pendency(curr);
+static bool so_saida_vazia(so_t *self) {
+    for (int t = 0; t < self->n_terminais; t++) {
+        if (self->saida[t].n > 0) {
+            return false;
+        }
+    }
+    return true;
+}
 
-        if (pendency == read) {
-            so_resolve_read(self, curr);
-        } else if (pendency == write) {
-            so_resolve_write(self, curr);
+// atende os processos da fila de um terminal, em ordem de chegada, até
+//   que um não possa ser atendido (o terminal não está mais pronto)
+static void so_atende_fila(so_t *self, ioqueue_t *fila) {
+    process_t *proc;
+    while ((proc = ioqueue_head(fila)) != NULL) {
+        bool ok;
+        if (process_pendency(proc) == read) {
+            ok = so_resolve_read(self, proc);
+        } else {
+            ok = so_resolve_write(self, proc);
+        }
+        if (!ok) {
+            break;
         }
+        ioqueue_remove(proc);
+    }
+}
 
-        curr = process_next(curr);
+// desbloqueia os processos cujas transferências de página terminaram
+static void so_resolve_paging(so_t *self) {
+    int now;
+    if (es_le(self->es, D_RELOGIO_INSTRUCOES, &now) != ERR_OK) {
+        self->erro_interno = true;
+        return;
     }
 
+    process_t *proc;
+    int quadro;
+    bool liberou = false;
+    while ((proc = swap_pop_done(self->swap, now, &quadro)) != NULL) {
+        ftable_lock(self->ftbl, quadro, false);
+        process_set_pendency(proc, none);
+        process_set_state(proc, ready);
+        liberou = true;
+    }
+    if (liberou) {
+        so_acorda_espera_quadro(self);
+    }
+}
+
+static void so_trata_pendencias(so_t *self) {
+
+    // as pendências de E/S nos terminais são atendidas nas interrupções
+    //   deles; só as transferências de página precisam ser verificadas aqui
+    so_resolve_paging(self);
+
     // Contabilidade
     logs.time_blocked += ptable_idle(self->ptbl) ? 1 : 0;
-    ptable_update_times(self->ptbl);
+    ptable_update_times(self->ptbl, 1);
 }
 
 static void so_escalona(so_t *self) {
@@ -279,7 +504,7 @@ static void so_escalona(so_t *self) {
 
     ptable_priority_mode(self->ptbl);
 
-    ptable_standard_mode(self->ptbl, true);
+    ptable_standard_mode(self->ptbl);
 }
 
 static int so_despacha(so_t *self) {
@@ -289,12 +514,59 @@ static int so_despacha(so_t *self) {
         return 1;
     }
 
-    process_load_registers(running, self->mem);
+    process_load_registers(running, self->cpu);
     mmu_define_tabpag(self->mmu, process_tabpag(running));
 
     return 0;
 }
 
+// se a interrupção é uma chamada de E/S (SO_LE, SO_ESCR, SO_ESCR_STR), que
+//   só altera o processo que a fez
+static bool so_chamada_de_es(so_t *self, irq_t irq) {
+    process_t *running = ptable_running_process(self->ptbl);
+    if (irq != IRQ_SISTEMA || running == NULL) {
+        return false;
+    }
+    int id_chamada = process_A(running);
+    return id_chamada == SO_LE || id_chamada == SO_ESCR || id_chamada == SO_ESCR_STR;
+}
+
+// o processo que fez a chamada pode continuar sem passar pelo escalonador:
+//   não bloqueou, e nenhum outro tem que mudar de estado (não terminou
+//   transferência de página); o quantum só acaba na interrupção do relógio,
+//   que não passa por aqui
+static bool so_pode_voltar_direto(so_t *self) {
+    process_t *running = ptable_running_process(self->ptbl);
+    if (self->erro_interno || running == NULL || process_state(running) != ready) {
+        return false;
+    }
+    int fim_transferencia = swap_next_done(self->swap);
+    if (fim_transferencia >= 0) {
+        int now;
+        es_le(self->es, D_RELOGIO_INSTRUCOES, &now);
+        return fim_transferencia > now;
+    }
+    return true;
+}
+
+// retorna ao processo corrente; a chamada só alterou o contexto dele, e a
+//   tabela de páginas na MMU continua sendo a dele
+static int so_volta_direto(so_t *self) {
+    process_t *running = ptable_running_process(self->ptbl);
+    process_load_registers(running, self->cpu);
+    return 0;
+}
+
+// contabiliza o tempo das interrupções tratadas pelo caminho rápido; nelas,
+//   nada mudou de estado e o processo corrente estava pronto (o sistema não
+//   estava ocioso)
+static void so_contabiliza_adiadas(so_t *self) {
+    if (self->n_adiadas > 0) {
+        ptable_update_times(self->ptbl, self->n_adiadas);
+        self->n_adiadas = 0;
+    }
+}
+
 // TRATAMENTO DE UMA IRQ {{{1
 
 // funções auxiliares para tratar cada tipo de interrupção
@@ -302,6 +574,7 @@ static void so_trata_irq_reset(so_t *self);
 static void so_trata_irq_chamada_sistema(so_t *self);
 static void so_trata_irq_err_cpu(so_t *self);
 static void so_trata_irq_relogio(so_t *self);
+static void so_trata_irq_terminal(so_t *self, irq_t irq);
 static void so_trata_irq_desconhecida(so_t *self, int irq);
 
 static void so_trata_irq(so_t *self, int irq) {
@@ -319,12 +592,39 @@ static void so_trata_irq(so_t *self, int irq) {
     case IRQ_RELOGIO:
         so_trata_irq_relogio(self);
         break;
+    case IRQ_TECLADO:
+    case IRQ_TELA:
+        so_trata_irq_terminal(self, irq);
+        break;
     default:
         so_trata_irq_desconhecida(self, irq);
     }
 }
 
 // interrupção gerada uma única vez, quando a CPU inicializa
+// dá ao processo o primeiro terminal livre; sem terminal livre, o processo
+//   fica sem (e as chamadas de E/S dele retornam erro)
+static void so_aloca_terminal(so_t *self, process_t *proc) {
+    for (int t = 0; t < self->n_terminais; t++) {
+        if (self->dono_terminal[t] == NULL) {
+            self->dono_terminal[t] = proc;
+            process_set_terminal(proc, t);
+            return;
+        }
+    }
+    console_printf("SO: sem terminal livre para o processo %d", process_pid(proc));
+}
+
+// o terminal do processo volta a ficar livre (o que estiver no buffer de
+//   saída continua sendo enviado)
+static void so_libera_terminal(so_t *self, process_t *proc) {
+    int t = process_terminal(proc);
+    if (t >= 0) {
+        self->dono_terminal[t] = NULL;
+        process_set_terminal(proc, -1);
+    }
+}
+
 static void so_trata_irq_reset(so_t *self) {
     // t1: deveria criar um processo para o init, e inicializar o estado do
     //   processador para esse processo com os registradores zerados, exceto
@@ -337,6 +637,7 @@ static void so_trata_irq_reset(so_t *self) {
     // t2: deveria criar um processo, e programar a tabela de páginas dele **********
     process_t *proc = process_create(); // deveria inicializar um processo...
     ptable_insert_process(self->ptbl, proc);
+    so_aloca_terminal(self, proc);
 
     int ender = so_carrega_programa(self, proc, "init.maq");
     if (ender != 0) {
@@ -345,73 +646,524 @@ static void so_trata_irq_reset(so_t *self) {
         return;
     }
 
+    es_le(self->es, D_RELOGIO_INSTRUCOES, &process_metrics(proc)->created_at);
+
     process_set_PC(proc, 0);
     process_set_modo(proc, usuario);
 
     ptable_set_running_process(self->ptbl, proc);
 }
 
-static void so_trata_err_pag_ausente(so_t *self) {
+static void so_mata_processo(so_t *self, process_t *proc);
+
+// número de páginas do processo (todas estão na memória secundária)
+static int so_paginas_do_processo(process_t *proc) {
+    return (process_disk_size(proc) + TAM_PAGINA - 1) / TAM_PAGINA;
+}
+
+// endereço na memória secundária da página 'pagina' do processo: na região
+//   do processo se ele já alterou a página, na imagem do programa se não
+static int so_end_disco_da_pagina(process_t *proc, int pagina) {
+    if (process_page_private(proc, pagina)) {
+        return process_disk_init(proc) + pagina * TAM_PAGINA;
+    }
+    return image_disk_init(process_image(proc)) + pagina * TAM_PAGINA;
+}
+
+// páginas compartilhadas: os processos que executam o mesmo programa
+//   compartilham os quadros com as páginas da imagem que ainda não foram
+//   alteradas (a imagem sabe em que quadro está cada página, ver
+//   image_frame). Um quadro compartilhado fica protegido contra escrita na
+//   tabela de páginas de todos que o mapeiam; quando um deles escreve,
+//   recebe uma cópia do quadro só para ele.
+
+// outro processo, diferente de 'proc', que mapeia 'quadro'
+static process_t *so_outro_que_mapeia(so_t *self, process_t *proc, int quadro) {
+    for (int i = 0; i < ftable_sharers(self->ftbl, quadro); i++) {
+        process_t *outro = ftable_sharer(self->ftbl, quadro, i);
+        if (outro != proc) {
+            return outro;
+        }
+    }
+    return NULL;
+}
+
+// o processo deixa de usar o quadro compartilhado, que continua com os outros;
+//   se era o dono, passa o quadro para um deles
+static void so_deixa_quadro_compartilhado(so_t *self, process_t *proc, int pagina, int quadro) {
+    ftable_unshare(self->ftbl, quadro, proc);
+    if (ftable_owner(self->ftbl, quadro) == proc) {
+        ftable_set_owner(self->ftbl, quadro, so_outro_que_mapeia(self, proc, quadro));
+        // o quadro só fica travado pela transferência que o dono pediu
+        ftable_lock(self->ftbl, quadro, false);
+    }
+}
+
+// o processo passa a ser o único a usar o quadro compartilhado, que ele vai
+//   alterar; os outros deixam de mapear a página
+static void so_toma_quadro_compartilhado(so_t *self, process_t *proc, int pagina, int quadro) {
+    while (ftable_sharers(self->ftbl, quadro) > 1) {
+        process_t *outro = so_outro_que_mapeia(self, proc, quadro);
+        tabpag_invalida_pagina(process_tabpag(outro), pagina);
+        ftable_unshare(self->ftbl, quadro, outro);
+    }
+    if (ftable_owner(self->ftbl, quadro) != proc) {
+        ftable_set_owner(self->ftbl, quadro, proc);
+        // o quadro só fica travado pela transferência que o dono pediu
+        ftable_lock(self->ftbl, quadro, false);
+    }
+    tabpag_protege_pagina(process_tabpag(proc), pagina, false);
+    image_set_frame(process_image(proc), pagina, -1);
+}
+
+// tenta atender a falta da página com o quadro que já tem a página da imagem
+//   sem alterações; retorna false se não tiver esse quadro
+static bool so_compartilha_pagina(so_t *self, process_t *proc, int pagina) {
+    image_t *imagem = process_image(proc);
+    if (process_page_private(proc, pagina)) {
+        return false;
+    }
+    int quadro = image_frame(imagem, pagina);
+    if (quadro < 0) {
+        return false;
+    }
+    // enquanto não é compartilhado, o quadro não é protegido, e o dono pode
+    //   ter escrito nele
+    tabpag_t *tabpag_dono = process_tabpag(ftable_owner(self->ftbl, quadro));
+    if (tabpag_bit_alteracao(tabpag_dono, pagina)) {
+        image_set_frame(imagem, pagina, -1);
+        return false;
+    }
+    tabpag_protege_pagina(tabpag_dono, pagina, true);
+
+    tabpag_t *tabpag = process_tabpag(proc);
+    tabpag_define_quadro(tabpag, pagina, quadro);
+    tabpag_protege_pagina(tabpag, pagina, true);
+    ftable_share(self->ftbl, quadro, proc);
+
+    self->n_shared_pages++;
+    return true;
+}
+
+// o processo não vai mais usar suas páginas; as compartilhadas continuam na
+//   memória para os outros, as outras deixam de estar na imagem
+static void so_libera_paginas_do_processo(so_t *self, process_t *proc) {
+    tabpag_t *tabpag = process_tabpag(proc);
+    int n_paginas = so_paginas_do_processo(proc);
+    for (int pagina = 0; pagina < n_paginas; pagina++) {
+        int quadro;
+        if (tabpag_traduz(tabpag, pagina, &quadro) != ERR_OK) {
+            continue;
+        }
+        if (ftable_sharers(self->ftbl, quadro) > 1) {
+            so_deixa_quadro_compartilhado(self, proc, pagina, quadro);
+        } else if (image_frame(process_image(proc), pagina) == quadro) {
+            image_set_frame(process_image(proc), pagina, -1);
+        }
+    }
+    ftable_release_process(self->ftbl, proc);
+}
+
+// libera o quadro 'quadro', que está ocupado, invalidando a página que está
+//   nele na tabela do dono (e na dos outros que compartilham o quadro)
+// se a página foi alterada, copia de volta para a região do dono na memória
+//   secundária; se não, a cópia do disco ainda vale, e a página é
+//   simplesmente descartada
+// retorna o número de páginas transferidas para o disco
+static int so_libera_quadro(so_t *self, int quadro) {
+    process_t *dono = ftable_owner(self->ftbl, quadro);
+    int pagina = ftable_page(self->ftbl, quadro);
+    tabpag_t *tabpag = process_tabpag(dono);
+    bool alterada = tabpag_bit_alteracao(tabpag, pagina);
+
+    if (alterada) {
+        int end_disco = process_disk_init(dono) + pagina * TAM_PAGINA;
+        if (mmu_copia_quadro(self->mmu, quadro, self->disk, end_disco) != ERR_OK) {
+            console_printf("SO: erro na cópia do quadro %d para o disco", quadro);
+            self->erro_interno = true;
+        }
+        process_set_page_private(dono, pagina);
+        process_metrics(dono)->dirty_writebacks++;
+        self->n_dirty_writebacks++;
+    } else {
+        process_metrics(dono)->clean_drops++;
+        self->n_clean_drops++;
+    }
+
+    while (ftable_sharers(self->ftbl, quadro) > 1) {
+        process_t *outro = so_outro_que_mapeia(self, dono, quadro);
+        tabpag_invalida_pagina(process_tabpag(outro), pagina);
+        ftable_unshare(self->ftbl, quadro, outro);
+    }
+    if (image_frame(process_image(dono), pagina) == quadro) {
+        image_set_frame(process_image(dono), pagina, -1);
+    }
+    tabpag_invalida_pagina(tabpag, pagina);
+    ftable_release(self->ftbl, quadro);
+    self->n_evictions++;
+
+    return alterada ? 1 : 0;
+}
+
+// obtém um quadro livre, liberando um se necessário; retorna -1 se não conseguir
+// '*ptransferencias' recebe o número de páginas transferidas para liberar
+static int so_obtem_quadro(so_t *self, int *ptransferencias) {
+    *ptransferencias = 0;
+    int quadro = ftable_find_free(self->ftbl);
+    if (quadro >= 0) {
+        return quadro;
+    }
+    quadro = ftable_choose_victim(self->ftbl);
+    if (quadro >= 0) {
+        *ptransferencias = so_libera_quadro(self, quadro);
+    }
+    return quadro;
+}
+
+// obtém um quadro para atender uma falta de página do processo 'proc', como
+//   so_obtem_quadro, sem escolher como vítima um quadro com o código da
+//   instrução que causou a falta (no PC, e o argumento dela em PC+1); senão,
+//   com poucos quadros, a instrução pode perder uma das páginas que usa
+//   sempre que consegue a outra, e nunca ser executada
+static int so_obtem_quadro_para_falta(so_t *self, process_t *proc, int *ptransferencias) {
+    tabpag_t *tabpag = process_tabpag(proc);
+    int quadros[2];
+    bool travados[2];
+    for (int i = 0; i < 2; i++) {
+        int end = process_PC(proc) + i;
+        if (end < 0 || tabpag_traduz(tabpag, end / TAM_PAGINA, &quadros[i]) != ERR_OK) {
+            quadros[i] = -1;
+            continue;
+        }
+        travados[i] = ftable_locked(self->ftbl, quadros[i]);
+        ftable_lock(self->ftbl, quadros[i], true);
+    }
+    int quadro = so_obtem_quadro(self, ptransferencias);
+    // na ordem inversa, para o caso de as duas serem o mesmo quadro
+    for (int i = 1; i >= 0; i--) {
+        if (quadros[i] >= 0) {
+            ftable_lock(self->ftbl, quadros[i], travados[i]);
+        }
+    }
+    return quadro;
+}
+
+// quadros fixados: com poucos quadros, a instrução que causou uma falta
+//   pode perder uma das páginas que usa (a do PC, a do argumento em PC+1 e a
+//   do dado) para a falta de outro processo, enquanto espera a transferência
+//   de outra, e as faltas se repetem sem que nenhuma instrução termine. Para
+//   que sempre tenha um processo progredindo, um processo de cada vez tem
+//   fixados os quadros da instrução que causou a falta, até que ela termine
+//   (o PC dele muda) ou ele morra. SO_MIN_QUADROS é o que basta para isso.
+
+// fixa 'quadro', que acabou de ser dado a 'proc' por uma falta, e os das
+//   páginas da instrução no PC, se outro processo não tiver quadros fixados
+static void so_fixa_quadros(so_t *self, process_t *proc, int quadro) {
+    if (self->fixado != NULL && self->fixado != proc) {
+        return;
+    }
+    self->fixado = proc;
+    self->pc_fixado = process_PC(proc);
+    self->fixado_espera = false;
+    ftable_pin(self->ftbl, quadro);
+    tabpag_t *tabpag = process_tabpag(proc);
+    for (int end = self->pc_fixado; end <= self->pc_fixado + 1; end++) {
+        int q;
+        if (end >= 0 && tabpag_traduz(tabpag, end / TAM_PAGINA, &q) == ERR_OK) {
+            ftable_pin(self->ftbl, q);
+        }
+    }
+}
 
-    console_printf("========");
+static void so_desfixa_quadros(so_t *self) {
+    ftable_unpin_all(self->ftbl);
+    self->fixado = NULL;
+    self->fixado_espera = false;
+    so_acorda_espera_quadro(self);
+}
+
+// desfixa os quadros se a instrução que os fixou já foi executada
+static void so_verifica_quadros_fixados(so_t *self) {
+    if (self->fixado != NULL && process_PC(self->fixado) != self->pc_fixado) {
+        so_desfixa_quadros(self);
+    }
+}
+
+// quando não se consegue um quadro para uma falta, é porque estão todos
+//   travados por transferências de página que ainda não terminaram ou
+//   fixados para a instrução de outro processo, ou porque não há quadros que
+//   possam ser usados
+// nos primeiros casos a falta não é atendida agora (ver so_espera_quadro)
+static bool so_quadros_retidos(so_t *self, process_t *proc) {
+    return swap_next_done(self->swap) >= 0
+        || (self->fixado != NULL && self->fixado != proc);
+}
+
+// se o processo com quadros fixados está esperando um quadro, e 'proc' é
+//   outro; o próximo quadro liberado é para aquele, senão os outros podem
+//   pegar sempre os quadros antes dele, e nenhuma instrução termina
+static bool so_cede_quadro(so_t *self, process_t *proc) {
+    return self->fixado_espera && self->fixado != proc;
+}
+
+// bloqueia o processo até que algum quadro seja liberado (uma transferência
+//   termina, os quadros fixados são desfixados ou um processo morre); então
+//   ele executa de novo a instrução que causou a falta
+static void so_espera_quadro(so_t *self, process_t *proc) {
+    if (proc == self->fixado) {
+        self->fixado_espera = true;
+    }
+    process_set_erro(proc, ERR_OK);
+    process_set_state(proc, blocked);
+    process_set_pendency(proc, paging);
+    ioqueue_append(&self->espera_quadro, proc);
+}
+
+static void so_acorda_espera_quadro(so_t *self) {
+    process_t *proc;
+    while ((proc = ioqueue_head(&self->espera_quadro)) != NULL) {
+        ioqueue_remove(proc);
+        process_set_pendency(proc, none);
+        process_set_state(proc, ready);
+    }
+}
+
+// copia a página 'pagina' do processo da memória secundária para 'quadro', e
+//   mapeia a página nesse quadro
+static void so_carrega_pagina(so_t *self, process_t *proc, int pagina, int quadro) {
+    int end_disco = so_end_disco_da_pagina(proc, pagina);
+    if (mmu_preenche_quadro(self->mmu, quadro, self->disk, end_disco) != ERR_OK) {
+        console_printf("SO: erro na cópia do disco para o quadro %d", quadro);
+        self->erro_interno = true;
+    }
+
+    tabpag_define_quadro(process_tabpag(proc), pagina, quadro);
+    ftable_occupy(self->ftbl, quadro, proc, pagina);
+    // uma página que veio da imagem pode ser compartilhada
+    if (!process_page_private(proc, pagina)) {
+        image_set_frame(process_image(proc), pagina, quadro);
+    }
+}
+
+// bloqueia o processo pelo tempo que o disco levaria para fazer
+//   'transferencias' transferências de página envolvendo 'quadro'; o quadro
+//   fica travado até lá, para não ser escolhido por outra falta
+static void so_espera_transferencias(so_t *self, process_t *proc, int quadro, int transferencias) {
+    if (transferencias == 0 || swap_page_time(self->swap) == 0) {
+        return;
+    }
+    int now;
+    es_le(self->es, D_RELOGIO_INSTRUCOES, &now);
+    swap_request(self->swap, now, proc, quadro, transferencias);
+    ftable_lock(self->ftbl, quadro, true);
+    process_set_state(proc, blocked);
+    process_set_pendency(proc, paging);
+}
+
+static void so_trata_err_pag_ausente(so_t *self) {
 
     process_t *running = ptable_running_process(self->ptbl);
-    tabpag_t *tabpag = process_tabpag(running);
 
     int virtual = process_complemento(running);
+    int pagina = virtual / TAM_PAGINA;
 
-    int init = process_disk_init(running);
+    if (virtual < 0 || pagina >= so_paginas_do_processo(running)) {
+        console_printf("SO: processo %d acessou endereço inválido %d", process_pid(running), virtual);
+        so_mata_processo(self, running);
+        return;
+    }
 
-    int init_virtual = (virtual / TAM_PAGINA) * TAM_PAGINA;
+    // a página pode já estar na memória, em um quadro de outro processo que
+    //   executa o mesmo programa; não precisa do disco
+    if (so_compartilha_pagina(self, running, pagina)) {
+        int quadro;
+        tabpag_traduz(process_tabpag(running), pagina, &quadro);
+        so_fixa_quadros(self, running, quadro);
+        process_set_erro(running, ERR_OK);
+        process_metrics(running)->page_faults++;
+        self->n_page_faults++;
+        return;
+    }
 
-    for (int i = init_virtual; i < init_virtual + TAM_PAGINA; i++) {
-        int valor;
-        mem_le(self->disk, i + init, &valor); // endereço no disco + init
-        mmu_escreve(self->mmu, i, valor, process_modo(running));
+    if (so_cede_quadro(self, running)) {
+        so_espera_quadro(self, running);
+        return;
+    }
+    int transferencias;
+    int quadro = so_obtem_quadro_para_falta(self, running, &transferencias);
+    if (quadro < 0 && so_quadros_retidos(self, running)) {
+        // a falta só é contada quando for atendida
+        so_espera_quadro(self, running);
+        return;
+    }
+    if (quadro < 0) {
+        console_printf("SO: sem quadros para a página %d do processo %d, que vai morrer", pagina, process_pid(running));
+        so_mata_processo(self, running);
+        return;
     }
 
-    fprintf(self->prints, "VIRTUAL: %d, END: %d, PAGINA: %d, QUADRO: %d\n", virtual, virtual + init, virtual / TAM_PAGINA, self->quadro_livre);
+    so_carrega_pagina(self, running, pagina, quadro);
+    so_fixa_quadros(self, running, quadro);
+    // o processo volta a executar a instrução que causou a falta
+    process_set_erro(running, ERR_OK);
+    process_metrics(running)->page_faults++;
+    self->n_page_faults++;
 
-    int tam = mem_tam(self->mem);
-    fprintf(self->prints, "[");
-    for (int i = 0; i < tam; i++) {
-        fprintf(self->prints, " %04d ", i);
+    // a cópia já foi feita, mas o processo fica bloqueado pelo tempo que o
+    //   disco levaria para fazer as transferências (a leitura da página e a
+    //   escrita da que saiu, se estava alterada)
+    so_espera_transferencias(self, running, quadro, transferencias + 1);
+
+    fprintf(self->prints, "PID: %d, VIRTUAL: %d, PAGINA: %d, QUADRO: %d\n", process_pid(running), virtual, pagina, quadro);
+}
+
+// escrita em uma página protegida, que é uma página da imagem do programa
+//   compartilhada: o processo passa a ter a sua própria cópia
+static void so_trata_err_pag_protegida(so_t *self) {
+
+    process_t *running = ptable_running_process(self->ptbl);
+    tabpag_t *tabpag = process_tabpag(running);
+
+    int pagina = process_complemento(running) / TAM_PAGINA;
+    int quadro;
+    if (tabpag_traduz(tabpag, pagina, &quadro) != ERR_OK) {
+        console_printf("SO: página %d do processo %d protegida sem estar mapeada", pagina, process_pid(running));
+        self->erro_interno = true;
+        return;
     }
-    fprintf(self->prints, "]\n");
-    fprintf(self->prints, "[");
-    for (int i = 0; i < tam; i++) {
-        int valor;
-        mem_le(self->mem, i, &valor);
-        fprintf(self->prints, " %04d ", valor);
+
+    // os outros já deixaram o quadro, ele pode ser alterado
+    if (ftable_sharers(self->ftbl, quadro) == 1) {
+        tabpag_protege_pagina(tabpag, pagina, false);
+        image_set_frame(process_image(running), pagina, -1);
+        process_set_erro(running, ERR_OK);
+        return;
     }
-    fprintf(self->prints, "]");
 
-    tabpag_define_quadro(tabpag, virtual / TAM_PAGINA, self->quadro_livre);
-    self->quadro_livre++;
+    if (so_cede_quadro(self, running)) {
+        so_espera_quadro(self, running);
+        return;
+    }
+
+    // o quadro compartilhado não pode ser a vítima para a cópia
+    bool travado = ftable_locked(self->ftbl, quadro);
+    ftable_lock(self->ftbl, quadro, true);
+    int transferencias;
+    int copia = so_obtem_quadro_para_falta(self, running, &transferencias);
+    ftable_lock(self->ftbl, quadro, travado);
+    if (copia < 0 && ftable_pinned(self->ftbl, quadro) && self->fixado != running) {
+        so_espera_quadro(self, running);
+        return;
+    }
+    if (copia < 0) {
+        // sem quadro para a cópia, o processo fica com o quadro compartilhado;
+        //   a página não foi alterada, os outros voltam a buscá-la na imagem
+        //   quando precisarem
+        so_toma_quadro_compartilhado(self, running, pagina, quadro);
+        so_fixa_quadros(self, running, quadro);
+        process_set_erro(running, ERR_OK);
+        return;
+    }
+
+    if (mmu_preenche_quadro(self->mmu, copia, self->mem, quadro * TAM_PAGINA) != ERR_OK) {
+        console_printf("SO: erro na cópia do quadro %d para o quadro %d", quadro, copia);
+        self->erro_interno = true;
+    }
+    so_deixa_quadro_compartilhado(self, running, pagina, quadro);
+    tabpag_define_quadro(tabpag, pagina, copia);
+    ftable_occupy(self->ftbl, copia, running, pagina);
+    so_fixa_quadros(self, running, copia);
+    process_set_erro(running, ERR_OK);
+    self->n_cow_copies++;
+
+    // a cópia é na memória, só espera pelo disco se teve que liberar um
+    //   quadro alterado para ela
+    so_espera_transferencias(self, running, copia, transferencias);
 }
 
 // interrupção gerada quando a CPU identifica um erro
 static void so_trata_irq_err_cpu(so_t *self) {
 
-    int err_int;
+    cpu_contexto_t ctx;
 
-    mem_le(self->mem, IRQ_END_erro, &err_int);
-    err_t err = err_int;
+    cpu_salva_contexto(self->cpu, &ctx);
+    err_t err = ctx.erro;
 
     if (err == ERR_PAG_AUSENTE) {
         so_trata_err_pag_ausente(self);
+    } else if (err == ERR_PAG_PROTEGIDA) {
+        so_trata_err_pag_protegida(self);
     } else {
         console_printf("SO: IRQ não tratada -- erro na CPU: %s", err_nome(err));
         self->erro_interno = true;
     }
 }
 
+static int so_compara_metricas(const void *a, const void *b) {
+    return ((metrics_t *)a)->pid - ((metrics_t *)b)->pid;
+}
+
+// escreve as métricas de cada processo que terminou, em ordem de pid, e
+//   as médias entre eles
+static void so_escreve_metricas_dos_processos(so_t *self, FILE *fp) {
+    int n = self->n_finished;
+    metrics_t *m = self->finished_metrics;
+    if (n == 0) {
+        return;
+    }
+    qsort(m, n, sizeof(metrics_t), so_compara_metricas);
+
+    double total_retorno = 0;
+    double total_resposta = 0;
+    int total_preempcoes = 0;
+
+    for (int i = 0; i < n; i++) {
+        int retorno = m[i].killed_at - m[i].created_at;
+        // tempo médio de resposta: tempo médio em ready cada vez que fica ready
+        float resposta = m[i].states[ready] ? m[i].state_time[ready] / (float)m[i].states[ready] : 0;
+
+        fprintf(fp, "PID %d\n", m[i].pid);
+        fprintf(fp, "\tTempo de retorno: %d\n", retorno);
+        fprintf(fp, "\tNo de preempções: %d\n", m[i].preemptions);
+        fprintf(fp, "\tNo de faltas de página: %d\n", m[i].page_faults);
+        fprintf(fp, "\t\tpáginas limpas descartadas: %d\n", m[i].clean_drops);
+        fprintf(fp, "\t\tpáginas alteradas copiadas: %d\n", m[i].dirty_writebacks);
+        fprintf(fp, "\tNo de vezes que entrou no estado\n");
+        fprintf(fp, "\t\tblocked: %d\n", m[i].states[blocked]);
+        fprintf(fp, "\t\tready: %d\n", m[i].states[ready]);
+        fprintf(fp, "\t\trunning: %d\n", m[i].states[running]);
+        fprintf(fp, "\tO tempo que ficou no estado\n");
+        fprintf(fp, "\t\tblocked: %d\n", m[i].state_time[blocked]);
+        fprintf(fp, "\t\tready: %d\n", m[i].state_time[ready]);
+        fprintf(fp, "\t\trunning: %d\n", m[i].state_time[running]);
+        fprintf(fp, "\tTempo médio de resposta: %f\n", resposta);
+        fprintf(fp, "\n");
+
+        total_retorno += retorno;
+        total_resposta += resposta;
+        total_preempcoes += m[i].preemptions;
+    }
+
+    fprintf(fp, "Processos terminados: %d\n", n);
+    fprintf(fp, "Tempo médio de retorno: %f\n", total_retorno / n);
+    fprintf(fp, "Tempo médio de resposta: %f\n", total_resposta / n);
+    fprintf(fp, "Média de preempções por processo: %f\n", total_preempcoes / (double)n);
+    fprintf(fp, "\n");
+}
+
 static void so_trata_irq_relogio(so_t *self) {
 
     err_t e1, e2;
 
     e1 = es_escreve(self->es, D_RELOGIO_INTERRUPCAO, 0);
-    e2 = es_escreve(self->es, D_RELOGIO_TIMER, INTERVALO_INTERRUPCAO);
+    // sem processos e sem saída pendente, não tem mais o que fazer: não
+    //   reprograma o timer, e a CPU fica parada (é assim que o controlador em
+    //   modo lote sabe que acabou); depois de um erro interno o SO não
+    //   executa mais processos, também acabou
+    bool acabou = self->erro_interno
+                  || (ptable_head(self->ptbl) == NULL && so_saida_vazia(self));
+    int timer = acabou ? 0 : INTERVALO_INTERRUPCAO;
+    e2 = es_escreve(self->es, D_RELOGIO_TIMER, timer);
 
     if (e1 != ERR_OK || e2 != ERR_OK) {
         self->erro_interno = true;
@@ -422,7 +1174,9 @@ static void so_trata_irq_relogio(so_t *self) {
         process_dec_quantum(running);
     }
 
-    if (ptable_head(self->ptbl) == NULL && !self->finished) {
+    ftable_tick(self->ftbl);
+
+    if (acabou && !self->finished) {
         self->finished = true;
 
         FILE *fp = fopen("logs.txt", "w");
@@ -439,51 +1193,30 @@ static void so_trata_irq_relogio(so_t *self) {
         fprintf(fp, "No de SO_CRIA_PROC: %d\n", logs.number_interruptions[2]);
         fprintf(fp, "No de SO_MATA_PROC: %d\n", logs.number_interruptions[3]);
         fprintf(fp, "No de SO_ESPERA_PROC: %d\n", logs.number_interruptions[4]);
+        fprintf(fp, "No de SO_ESCR_STR: %d\n", logs.number_interruptions[5]);
 
         fprintf(fp, "No de preempções: %d\n", logs.number_preemptions);
         fprintf(fp, "\n");
 
-        for (int i = 1; i < logs.process_created + 1; i++) {
-            fprintf(fp, "Tempo de retorno PID %d: %d\n", i, logs.process_killed_at[i] - logs.process_created_at[i]);
-        }
+        fprintf(fp, "Política de substituição: %s\n", ftable_policy_name(ftable_policy(self->ftbl)));
+        fprintf(fp, "No de faltas de página: %d\n", self->n_page_faults);
+        fprintf(fp, "No de substituições: %d\n", self->n_evictions);
+        fprintf(fp, "\tpáginas limpas descartadas: %d\n", self->n_clean_drops);
+        fprintf(fp, "\tpáginas alteradas copiadas: %d\n", self->n_dirty_writebacks);
+        fprintf(fp, "Páginas compartilhadas: %d\n", self->n_shared_pages);
+        fprintf(fp, "Cópias de páginas compartilhadas alteradas: %d\n", self->n_cow_copies);
         fprintf(fp, "\n");
 
-        for (int i = 1; i < logs.process_created + 1; i++) {
-            fprintf(fp, "No de preempções PID %d: %d\n", i, logs.number_preemptions_process[i]);
-        }
-        fprintf(fp, "\n");
-
-        for (int i = 1; i < logs.process_created + 1; i++) {
-            fprintf(fp, "No de vezes que PID %d entrou no estado\n", i);
-            fprintf(fp, "\tblocked: %d\n", logs.number_states_process[i][0]);
-            fprintf(fp, "\tready: %d\n", logs.number_states_process[i][1]);
-            fprintf(fp, "\trunning: %d\n", logs.number_states_process[i][2]);
-        }
-        fprintf(fp, "\n");
-
-        for (int i = 1; i < logs.process_created + 1; i++) {
-            fprintf(fp, "O tempo que PID %d ficou no estado\n", i);
-            fprintf(fp, "\tblocked: %d\n", logs.process_state_time[i][0]);
-            fprintf(fp, "\tready: %d\n", logs.process_state_time[i][1]);
-            fprintf(fp, "\trunning: %d\n", logs.process_state_time[i][2]);
-        }
-        fprintf(fp, "\n");
-
-        for (int i = 1; i < logs.process_created + 1; i++) {
-            fprintf(fp,
-                    "Tempo médio de resposta do PID %d: %f\n",
-                    i,
-                    logs.process_state_time[i][1] / (float)logs.number_states_process[i][1]);
-        }
-        fprintf(fp, "\n");
+        so_escreve_metricas_dos_processos(self, fp);
 
+        // só a parte usada do disco (o resto está no arquivo, zerado)
         fprintf(fp, "[");
-        for (int i = 0; i < DISK_TAM; i++) {
+        for (int i = 0; i < pos_livre; i++) {
             fprintf(fp, " %04d ", i);
         }
         fprintf(fp, "]\n");
         fprintf(fp, "[");
-        for (int i = 0; i < DISK_TAM; i++) {
+        for (int i = 0; i < pos_livre; i++) {
             int valor;
             mem_le(self->disk, i, &valor);
             fprintf(fp, " %04d ", valor);
@@ -491,6 +1224,40 @@ static void so_trata_irq_relogio(so_t *self) {
         fprintf(fp, "]");
 
         fclose(fp);
+
+        console_printf("SO: %d faltas de página, %d substituições (%d alteradas) (%s)",
+                       self->n_page_faults,
+                       self->n_evictions,
+                       self->n_dirty_writebacks,
+                       ftable_policy_name(ftable_policy(self->ftbl)));
+    }
+}
+
+// interrupção de teclado ou de tela de um ou mais terminais
+// o controlador informa quais terminais interromperam; as interrupções são
+//   reconhecidas e os processos que esperam esses terminais são atendidos
+static void so_trata_irq_terminal(so_t *self, irq_t irq) {
+    dispositivo_id_t disp = irq == IRQ_TECLADO ? D_TERM_INT_TECLADO : D_TERM_INT_TELA;
+
+    int terminais;
+    if (es_le(self->es, disp, &terminais) != ERR_OK
+        || es_escreve(self->es, disp, terminais) != ERR_OK) {
+        console_printf("SO: problema no controle de interrupção dos terminais");
+        self->erro_interno = true;
+        return;
+    }
+
+    for (int t = 0; t < self->n_terminais; t++) {
+        if (terminais & (1 << t)) {
+            if (irq == IRQ_TECLADO) {
+                so_atende_fila(self, &self->espera_teclado[t]);
+            } else {
+                // o que sair do buffer abre espaço para quem espera escrever
+                so_esvazia_saida(self, t);
+                so_atende_fila(self, &self->espera_tela[t]);
+                so_esvazia_saida(self, t);
+            }
+        }
     }
 }
 
@@ -505,6 +1272,7 @@ static void so_trata_irq_desconhecida(so_t *self, int irq) {
 // funções auxiliares para cada chamada de sistema
 static void so_chamada_le(so_t *self);
 static void so_chamada_escr(so_t *self);
+static void so_chamada_escr_str(so_t *self);
 static void so_chamada_cria_proc(so_t *self);
 static void so_chamada_mata_proc(so_t *self);
 static void so_chamada_espera_proc(so_t *self);
@@ -524,6 +1292,10 @@ static void so_trata_irq_chamada_sistema(so_t *self) {
         so_chamada_escr(self);
         logs.number_interruptions[1]++;
         break;
+    case SO_ESCR_STR:
+        so_chamada_escr_str(self);
+        logs.number_interruptions[5]++;
+        break;
     case SO_CRIA_PROC:
         so_chamada_cria_proc(self);
         logs.number_interruptions[2]++;
@@ -539,8 +1311,7 @@ static void so_trata_irq_chamada_sistema(so_t *self) {
     default:
         console_printf("SO: chamada de sistema desconhecida (%d)", id_chamada);
 
-        ptable_remove_process(self->ptbl, running);
-        process_free(running);
+        so_mata_processo(self, running);
 
         self->erro_interno = true;
     }
@@ -552,23 +1323,24 @@ static void so_chamada_le(so_t *self) {
 
     process_t *running = ptable_running_process(self->ptbl);
 
-    int teclado = 4 * process_pid(running) + D_TERM_A_TECLADO;
-    int teclado_ok = 4 * process_pid(running) + D_TERM_A_TECLADO_OK;
-
-    int available;
-    if (es_le(self->es, teclado_ok, &available) != ERR_OK) {
-        self->erro_interno = true;
+    int t = process_terminal(running);
+    if (t < 0) {
+        process_set_A(running, -1);
         return;
     }
 
-    if (!available) {
+    int teclado = D_TERMINAL(t, D_TERM_A_TECLADO);
+
+    int data;
+    err_t err = es_le(self->es, teclado, &data);
+
+    if (err == ERR_OCUP) {
         process_set_state(running, blocked);
         process_set_pendency(running, read);
+        ioqueue_append(&self->espera_teclado[t], running);
         return;
     }
-
-    int data;
-    if (es_le(self->es, teclado, &data) != ERR_OK) {
+    if (err != ERR_OK) {
         self->erro_interno = true;
         return;
     }
@@ -576,33 +1348,38 @@ static void so_chamada_le(so_t *self) {
     process_set_A(running, data);
 }
 
-static void so_chamada_escr(so_t *self) {
+// escrita buferizada, do caractere (SO_ESCR) ou da string (SO_ESCR_STR) do
+//   processo corrente; bloqueia o processo se o buffer de saída estiver cheio
+static void so_escreve_na_saida(so_t *self, pendency_t pendency) {
 
     process_t *running = ptable_running_process(self->ptbl);
 
-    int tela = 4 * process_pid(running) + D_TERM_A_TELA;
-    int tela_ok = 4 * process_pid(running) + D_TERM_A_TELA_OK;
-
-    int available;
-    if (es_le(self->es, tela_ok, &available) != ERR_OK) {
-        self->erro_interno = true;
+    int t = process_terminal(running);
+    if (t < 0) {
+        process_set_A(running, -1);
         return;
     }
 
-    if (!available) {
+    if (!so_bufferiza_saida(self, running, pendency)) {
         process_set_state(running, blocked);
-        process_set_pendency(running, write);
+        process_set_pendency(running, pendency);
+        ioqueue_append(&self->espera_tela[t], running);
         return;
     }
 
-    int data = process_X(running);
+    so_esvazia_saida(self, t);
+}
 
-    if (es_escreve(self->es, tela, data) != ERR_OK) {
-        self->erro_interno = true;
-        return;
-    }
+// implementação da chamada se sistema SO_ESCR
+// escreve o caractere em X na saída do processo
+static void so_chamada_escr(so_t *self) {
+    so_escreve_na_saida(self, write);
+}
 
-    process_set_A(running, 0);
+// implementação da chamada se sistema SO_ESCR_STR
+// escreve a string no endereço em X na saída do processo
+static void so_chamada_escr_str(so_t *self) {
+    so_escreve_na_saida(self, write_str);
 }
 
 // implementação da chamada se sistema SO_CRIA_PROC
@@ -617,21 +1394,24 @@ static void so_chamada_cria_proc(so_t *self) {
         return;
     }
 
+    // o processo só entra na tabela e recebe um terminal se o programa
+    //   puder ser carregado
     process_t *created = process_create();
-    ptable_insert_process(self->ptbl, created);
-
     int mem_address = so_carrega_programa(self, created, nome);
     if (mem_address != 0) {
+        process_free(created);
         process_set_A(running, -1);
         return;
     }
+    ptable_insert_process(self->ptbl, created);
+    so_aloca_terminal(self, created);
 
     process_set_PC(created, 0);
     process_set_A(running, process_pid(created));
 
     // Contabilidade
     logs.process_created++;
-    es_le(self->es, D_RELOGIO_INSTRUCOES, &logs.process_created_at[process_pid(created)]);
+    es_le(self->es, D_RELOGIO_INSTRUCOES, &process_metrics(created)->created_at);
 }
 
 static void so_chamada_mata_proc(so_t *self) {
@@ -643,19 +1423,50 @@ static void so_chamada_mata_proc(so_t *self) {
     process_t *found = pid == 0 ? running : ptable_find(self->ptbl, pid);
 
     if (found) {
-        ptable_remove_process(self->ptbl, found);
-        wlist_solve(self->wlst, found);
+        so_mata_processo(self, found);
+    }
+}
 
-        if (pid == 0) {
-            ptable_set_running_process(self->ptbl, NULL);
-        }
+// guarda uma cópia das métricas de um processo que terminou, para o relatório
+static void so_guarda_metricas(so_t *self, metrics_t *metrics) {
+    if (self->n_finished == self->cap_finished) {
+        self->cap_finished = self->cap_finished ? 2 * self->cap_finished : 16;
+        self->finished_metrics = realloc(self->finished_metrics, self->cap_finished * sizeof(metrics_t));
+        assert(self->finished_metrics != NULL);
+    }
+    self->finished_metrics[self->n_finished++] = *metrics;
+}
+
+static void so_mata_processo(so_t *self, process_t *proc) {
+
+    bool corrente = proc == ptable_running_process(self->ptbl);
+
+    if (proc == self->fixado) {
+        so_desfixa_quadros(self);
+    }
+
+    ptable_remove_process(self->ptbl, proc);
+    process_wake_waiters(proc);
 
-        // Por quê?
-        process_set_state(found, ready);
+    if (corrente) {
+        ptable_set_running_process(self->ptbl, NULL);
+        // a tabela de páginas do processo vai ser destruída, a MMU não pode
+        //   continuar com ela
+        mmu_define_tabpag(self->mmu, NULL);
     }
 
+    // os quadros e o terminal do processo ficam livres
+    swap_cancel(self->swap, proc);
+    so_libera_paginas_do_processo(self, proc);
+    so_libera_terminal(self, proc);
+    so_acorda_espera_quadro(self);
+
     // Contabilidade
-    es_le(self->es, D_RELOGIO_INSTRUCOES, &logs.process_killed_at[process_pid(found)]);
+    metrics_t *metrics = process_metrics(proc);
+    es_le(self->es, D_RELOGIO_INSTRUCOES, &metrics->killed_at);
+    so_guarda_metricas(self, metrics);
+
+    process_free(proc);
 }
 
 static void so_chamada_espera_proc(so_t *self) {
@@ -667,8 +1478,7 @@ static void so_chamada_espera_proc(so_t *self) {
     process_t *found = ptable_find(self->ptbl, pid);
 
     if (found) {
-        waiting_t *wt = waiting_alloc(running, found);
-        wlist_insert(self->wlst, wt);
+        process_add_waiter(found, running);
         process_set_state(running, blocked);
     } else {
         process_set_state(running, ready);
@@ -679,24 +1489,29 @@ static void so_chamada_espera_proc(so_t *self) {
 
 // funções auxiliares
 static int so_carrega_programa_na_memoria_fisica(so_t *self, programa_t *programa);
-static int so_carrega_programa_na_memoria_virtual(so_t *self, programa_t *programa, process_t *processo);
+static image_t *so_imagem_do_programa(so_t *self, char *nome_do_executavel);
+static int so_carrega_imagem_na_memoria_virtual(so_t *self, image_t *imagem, process_t *processo);
 
 // carrega o programa na memória de um processo ou na memória física se NENHUM_PROCESSO
 // retorna o endereço de carga ou -1
 static int so_carrega_programa(so_t *self, process_t *processo, char *nome_do_executavel) {
     console_printf("SO: carga de '%s'", nome_do_executavel);
 
+    if (processo != NULL) {
+        image_t *imagem = so_imagem_do_programa(self, nome_do_executavel);
+        if (imagem == NULL) {
+            return -1;
+        }
+        return so_carrega_imagem_na_memoria_virtual(self, imagem, processo);
+    }
+
     programa_t *programa = prog_cria(nome_do_executavel);
     if (programa == NULL) {
         console_printf("Erro na leitura do programa '%s'\n", nome_do_executavel);
         return -1;
     }
 
-    int end_carga;
-    if (processo == NULL) {
-        end_carga = so_carrega_programa_na_memoria_fisica(self, programa);
-    } else { end_carga = so_carrega_programa_na_memoria_virtual(self, programa, processo);
-    }
+    int end_carga = so_carrega_programa_na_memoria_fisica(self, programa);
 
     prog_destroi(programa);
     return end_carga;
@@ -712,69 +1527,106 @@ static int so_carrega_programa_na_memoria_fisica(so_t *self, programa_t *program
             return -1;
         }
     }
+    // a carga não passou pela MMU, o conteúdo desses quadros mudou
+    for (int quadro = end_ini / TAM_PAGINA; quadro <= (end_fim - 1) / TAM_PAGINA; quadro++) {
+        mmu_invalida_quadro(self->mmu, quadro);
+    }
     console_printf("carregado na memória física, %d-%d", end_ini, end_fim);
     return end_ini;
 }
 
-static int so_carrega_programa_na_memoria_virtual(so_t *self, programa_t *programa, process_t *proc) {
+// retorna a imagem do programa na memória secundária, a partir de um início
+//   de página; o programa só é lido e copiado para lá se não estiver na cache
+//   de imagens (ou se o arquivo mudou desde que foi lido)
+// retorna NULL em caso de erro
+static image_t *so_imagem_do_programa(so_t *self, char *nome_do_executavel) {
+    struct stat st;
+    if (stat(nome_do_executavel, &st) != 0) {
+        console_printf("Erro na leitura do programa '%s'\n", nome_do_executavel);
+        return NULL;
+    }
+    image_t *imagem = pcache_find(self->pcache, nome_do_executavel, st.st_mtime);
+    if (imagem != NULL) {
+        return imagem;
+    }
 
-    mmu_define_tabpag(self->mmu, process_tabpag(proc));
+    programa_t *programa = prog_cria(nome_do_executavel);
+    if (programa == NULL) {
+        console_printf("Erro na leitura do programa '%s'\n", nome_do_executavel);
+        return NULL;
+    }
 
     int end_virt_ini = prog_end_carga(programa);
-    int end_virt_fim = end_virt_ini + prog_tamanho(programa) - 1;
-    int pagina_ini = end_virt_ini / TAM_PAGINA;
-    int pagina_fim = end_virt_fim / TAM_PAGINA;
-    int quadro_ini = self->quadro_livre;
+    int end_virt_fim = end_virt_ini + prog_tamanho(programa);
+    int n_paginas = (end_virt_fim + TAM_PAGINA - 1) / TAM_PAGINA;
 
-    // mapeia as páginas nos quadros
-    int quadro = quadro_ini;
-    for (int pagina = pagina_ini; pagina <= pagina_fim; pagina++) {
-        tabpag_define_quadro(process_tabpag(proc), pagina, quadro);
-        quadro++;
+    if (pos_livre + n_paginas * TAM_PAGINA > DISK_TAM) {
+        console_printf("SO: memória secundária cheia");
+        prog_destroi(programa);
+        return NULL;
     }
-    self->quadro_livre = quadro;
-
-    // carrega o programa na memória principal
-    int end_fis_ini = quadro_ini * TAM_PAGINA;
-    int end_fis = end_fis_ini;
 
-    for (int end_virt = end_virt_ini; end_virt <= end_virt_fim; end_virt++) {
-        mmu_escreve(self->mmu, end_virt, prog_dado(programa, end_virt), process_modo(proc));
-        end_fis++;
+    for (int end_virt = end_virt_ini; end_virt < end_virt_fim; end_virt++) {
+        mem_escreve(self->disk, pos_livre + end_virt, prog_dado(programa, end_virt));
     }
+    imagem = pcache_insert(self->pcache, nome_do_executavel, st.st_mtime,
+                           pos_livre, n_paginas, end_virt_fim, end_virt_ini);
+    pos_livre += n_paginas * TAM_PAGINA;
+
+    prog_destroi(programa);
+    return imagem;
+}
 
-    // Carrega dados no disco.
-    
-    process_set_disk(proc, pos_livre, prog_tamanho(programa));
+// o processo recebe uma região na memória secundária do tamanho da imagem,
+//   que não é preenchida: as páginas são lidas da imagem, e só as que o
+//   processo alterar vão para a região dele; a tabela de páginas do processo
+//   fica vazia, e as páginas são trazidas para a memória principal quando
+//   faltarem
+static int so_carrega_imagem_na_memoria_virtual(so_t *self, image_t *imagem, process_t *proc) {
+    int n_paginas = image_n_pages(imagem);
 
-    for (int i = 0; i < prog_tamanho(programa); i++) {
-        mem_escreve(self->disk, pos_livre, prog_dado(programa, i));
-        pos_livre++;
+    if (pos_livre + n_paginas * TAM_PAGINA > DISK_TAM) {
+        console_printf("SO: memória secundária cheia");
+        return -1;
     }
 
-    // console_printf("carregado na memória virtual V%d-%d F%d-%d", end_virt_ini, end_virt_fim, end_fis_ini, end_fis - 1);
-    return 0;
+    process_set_disk(proc, pos_livre, image_size(imagem));
+    process_set_image(proc, imagem);
+    pos_livre += n_paginas * TAM_PAGINA;
+
+    return image_load_addr(imagem);
 }
 
 // ACESSO À MEMÓRIA DOS PROCESSOS {{{1
 
+// lê o valor no endereço virtual 'end_virt' do processo, que pode estar na
+//   memória principal ou só na secundária
+// retorna false se o endereço for inválido
+static bool so_le_mem_do_processo(so_t *self, process_t *proc, int end_virt, int *pvalor) {
+    int pagina = end_virt / TAM_PAGINA;
+    if (end_virt < 0 || pagina >= so_paginas_do_processo(proc)) {
+        return false;
+    }
+    int quadro;
+    if (tabpag_traduz(process_tabpag(proc), pagina, &quadro) == ERR_OK) {
+        return mem_le(self->mem, quadro * TAM_PAGINA + end_virt % TAM_PAGINA, pvalor) == ERR_OK;
+    }
+    return mem_le(self->disk, so_end_disco_da_pagina(proc, pagina) + end_virt % TAM_PAGINA, pvalor) == ERR_OK;
+}
+
 // copia uma string da memória do processo para o vetor str.
 // retorna false se erro (string maior que vetor, valor não char na memória,
 //   erro de acesso à memória)
 // O endereço é um endereço virtual de um processo.
-// T2: Com memória virtual, cada valor do espaço de endereçamento do processo
-//   pode estar em memória principal ou secundária (e tem que achar onde)
 static bool so_copia_str_do_processo(so_t *self, int tam, char str[tam], int end_virt, process_t *processo) {
     if (processo == NULL)
         return false;
     for (int indice_str = 0; indice_str < tam; indice_str++) {
         int caractere;
-        // não tem memória virtual implementada, posso usar a mmu para traduzir
-        //   os endereços e acessar a memória
-        if (mmu_le(self->mmu, end_virt + indice_str, &caractere, usuario) != ERR_OK) {
+        if (!so_le_mem_do_processo(self, processo, end_virt + indice_str, &caractere)) {
             return false;
         }
-        if (caractere < 0 || caractere > 255) {
+        if (!so_eh_caractere(caractere)) {
             return false;
         }
         str[indice_str] = caractere;
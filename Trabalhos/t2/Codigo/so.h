@@ -18,6 +18,22 @@ so_t *so_cria(cpu_t *cpu, mem_t *mem, mmu_t *mmu,
               es_t *es, console_t *console);
 void so_destroi(so_t *self);
 
+// define a política de substituição de páginas ("fifo", "clock", "nru" ou
+//   "aging"); retorna false se a política não existir
+bool so_define_politica_de_substituicao(so_t *self, char *nome);
+
+// define o tempo (em instruções) de transferência de uma página entre a
+//   memória principal e a secundária; com 0, as trocas não bloqueiam
+void so_define_tempo_de_troca(so_t *self, int tempo);
+
+// tamanho da área no início da memória principal que é usada pelo SO (estado
+//   da CPU, tratador de interrupção) e não é dada a processos
+#define SO_MEM_RESERVADA 100
+// número mínimo de quadros além da área reservada: uma instrução pode usar
+//   três páginas (a do código, a do argumento e a do dado acessado), e não
+//   pode ser executada se não couberem todas na memória
+#define SO_MIN_QUADROS 3
+
 // Chamadas de sistema
 // Uma chamada de sistema é realizada colocando a identificação da
 //   chamada (um dos valores abaixo) no registrador A e executando a
@@ -37,10 +53,22 @@ void so_destroi(so_t *self);
 #define SO_LE          1
 
 // escreve um caractere no dispositivo de saída do processo
-// recebe em X o caractere a escrever
-// retorna em A: 0 se OK ou um código de erro negativo
+// recebe em X o caractere a escrever (um byte, de -128 a 255)
+// retorna em A: 0 se OK ou um código de erro negativo (inclusive se X não
+//   for um caractere)
 #define SO_ESCR        2
 
+// escreve uma string no dispositivo de saída do processo
+// recebe em X o endereço da string, terminada por um valor 0
+// a escrita é buferizada pelo SO; são aceitos os caracteres que couberem no
+//   buffer de saída do processo, que pode ser menos que a string toda
+// bloqueia o processo chamador se o buffer estiver cheio
+// retorna em A: o número de caracteres aceitos (a chamada deve ser repetida
+//   para o resto da string; 0 se a string for vazia) ou um código de erro
+//   negativo, se o primeiro valor não puder ser lido ou não for um caractere
+//   (um valor assim depois do primeiro termina a string aceita)
+#define SO_ESCR_STR   10
+
 // #define SO_ABRE        3
 // #define SO_FECHA       4
 // #define SO_SEL_LE      5
@@ -0,0 +1,132 @@
+#include "swap.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+typedef struct request request_t;
+
+struct request {
+    process_t *proc;
+    int frame;
+    int done_at;
+    request_t *next;
+};
+
+struct swap {
+    mem_t *disk;
+    int page_time;
+    int free_at;
+    // fila de pedidos, em ordem de término
+    request_t *head;
+    request_t *tail;
+};
+
+swap_t *swap_create(int size, char *file, int page_time) {
+    swap_t *swp = calloc(1, sizeof(swap_t));
+    assert(swp != NULL);
+
+    if (file) {
+        swp->disk = mem_cria_arquivo(size, file);
+    }
+    if (!swp->disk) {
+        swp->disk = mem_cria(size);
+    }
+    swp->page_time = page_time;
+
+    return swp;
+}
+
+void swap_free(swap_t *swp) {
+    request_t *curr = swp->head;
+
+    while (curr) {
+        request_t *next = curr->next;
+        free(curr);
+        curr = next;
+    }
+
+    mem_destroi(swp->disk);
+    free(swp);
+}
+
+mem_t *swap_disk(swap_t *swp) {
+    return swp->disk;
+}
+
+void swap_set_page_time(swap_t *swp, int page_time) {
+    swp->page_time = page_time;
+}
+
+int swap_page_time(swap_t *swp) {
+    return swp->page_time;
+}
+
+int swap_request(swap_t *swp, int now, process_t *proc, int frame, int n_pages) {
+    // se o disco está livre, começa agora; senão, depois do último pedido
+    if (swp->free_at < now) {
+        swp->free_at = now;
+    }
+    swp->free_at += n_pages * swp->page_time;
+
+    request_t *req = calloc(1, sizeof(request_t));
+    assert(req != NULL);
+
+    req->proc = proc;
+    req->frame = frame;
+    req->done_at = swp->free_at;
+
+    if (swp->tail) {
+        swp->tail->next = req;
+    } else {
+        swp->head = req;
+    }
+    swp->tail = req;
+
+    return req->done_at;
+}
+
+process_t *swap_pop_done(swap_t *swp, int now, int *pframe) {
+    request_t *req = swp->head;
+
+    if (!req || req->done_at > now) {
+        return NULL;
+    }
+
+    swp->head = req->next;
+    if (!swp->head) {
+        swp->tail = NULL;
+    }
+
+    process_t *proc = req->proc;
+    *pframe = req->frame;
+    free(req);
+
+    return proc;
+}
+
+int swap_next_done(swap_t *swp) {
+    return swp->head ? swp->head->done_at : -1;
+}
+
+void swap_cancel(swap_t *swp, process_t *proc) {
+    request_t *prev = NULL;
+    request_t *curr = swp->head;
+
+    while (curr) {
+        request_t *next = curr->next;
+        if (curr->proc == proc) {
+            if (prev) {
+                prev->next = next;
+            } else {
+                swp->head = next;
+            }
+            if (swp->tail == curr) {
+                swp->tail = prev;
+            }
+            free(curr);
+        } else {
+            prev = curr;
+        }
+        curr = next;
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef SWAP_H
+#define SWAP_H
+
+#include "memoria.h"
+#include "ptable.h"
+
+// Dispositivo de memória secundária (disco de troca de páginas).
+// O conteúdo fica em uma mem_t. As transferências de páginas são feitas uma
+//   por vez, cada uma levando page_time unidades de tempo (instruções); o
+//   disco mantém o momento em que estará livre (free_at), e cada pedido é
+//   colocado em uma fila, com o momento em que vai terminar. O processo que
+//   fez o pedido fica bloqueado até lá.
+
+typedef struct swap swap_t;
+
+// o conteúdo é mantido no arquivo 'file' (ver mem_cria_arquivo), ou na
+//   memória do simulador se 'file' for NULL ou não puder ser usado
+swap_t *swap_create(int size, char *file, int page_time);
+void swap_free(swap_t *swp);
+
+// memória com o conteúdo do disco
+mem_t *swap_disk(swap_t *swp);
+
+void swap_set_page_time(swap_t *swp, int page_time);
+int swap_page_time(swap_t *swp);
+
+// enfileira um pedido de 'n_pages' transferências para o processo 'proc',
+//   feito no momento 'now'; 'frame' é o quadro envolvido, que não deve ser
+//   substituído até o fim do pedido
+// retorna o momento em que o pedido termina
+int swap_request(swap_t *swp, int now, process_t *proc, int frame, int n_pages);
+
+// retira da fila o primeiro pedido que já terminou no momento 'now'
+// coloca o quadro do pedido em '*pframe' e retorna o processo, ou retorna NULL
+//   se nenhum pedido terminou
+process_t *swap_pop_done(swap_t *swp, int now, int *pframe);
+
+// momento em que termina o primeiro pedido da fila, -1 se a fila está vazia
+int swap_next_done(swap_t *swp);
+
+// remove os pedidos de um processo (que morreu)
+void swap_cancel(swap_t *swp, process_t *proc);
+
+#endif // SWAP_H
@@ -17,6 +17,8 @@ typedef struct {
   bool acessada;
   // a página foi alterada ou não
   bool alterada;
+  // a página está protegida contra escrita ou não
+  bool protegida;
 } descritor_t;
 
 struct tabpag_t {
@@ -26,14 +28,27 @@ struct tabpag_t {
   // o último descritor do vetor sempre contém uma página válida
   // pode ser NULL (se tam_tab == 0)
   descritor_t *tabela;
+  // versão da tabela, muda a cada alteração que invalida cópias da tabela
+  unsigned versao;
+  // muda quando algum bit de acesso é zerado (as traduções continuam valendo)
+  unsigned versao_acesso;
 };
 
+// gera uma nova versão, diferente de todas as anteriores de qualquer tabela
+static unsigned tabpag__nova_versao(void)
+{
+  static unsigned ultima_versao = 0;
+  return ++ultima_versao;
+}
+
 tabpag_t *tabpag_cria(void)
 {
   tabpag_t *self = malloc(sizeof(*self));
   assert(self != NULL);
   self->tam_tab = 0;
   self->tabela = NULL;
+  self->versao = tabpag__nova_versao();
+  self->versao_acesso = 0;
   return self;
 }
 
@@ -56,6 +71,7 @@ void tabpag_invalida_pagina(tabpag_t *self, int pagina)
 {
   // página já é inválida -- não faz nada
   if (!tabpag__pagina_valida(self, pagina)) return;
+  self->versao = tabpag__nova_versao();
   // página não é a última da tabela -- marca como inválida
   if (pagina < self->tam_tab - 1) {
     self->tabela[pagina].valida = false;
@@ -96,10 +112,26 @@ void tabpag_define_quadro(tabpag_t *self, int pagina, int quadro)
 {
   assert(pagina >= 0);
   tabpag__insere_pagina(self, pagina);
+  self->versao = tabpag__nova_versao();
   self->tabela[pagina].quadro = quadro;
   self->tabela[pagina].valida = true;
   self->tabela[pagina].acessada = false;
   self->tabela[pagina].alterada = false;
+  self->tabela[pagina].protegida = false;
+}
+
+void tabpag_protege_pagina(tabpag_t *self, int pagina, bool protegida)
+{
+  if (!tabpag__pagina_valida(self, pagina)) return;
+  if (self->tabela[pagina].protegida == protegida) return;
+  self->versao = tabpag__nova_versao();
+  self->tabela[pagina].protegida = protegida;
+}
+
+bool tabpag_pagina_protegida(tabpag_t *self, int pagina)
+{
+  if (!tabpag__pagina_valida(self, pagina)) return false;
+  return self->tabela[pagina].protegida;
 }
 
 void tabpag_marca_bit_acesso(tabpag_t *self, int pagina, bool alteracao)
@@ -114,6 +146,8 @@ void tabpag_marca_bit_acesso(tabpag_t *self, int pagina, bool alteracao)
 void tabpag_zera_bit_acesso(tabpag_t *self, int pagina)
 {
   if (!tabpag__pagina_valida(self, pagina)) return;
+  if (!self->tabela[pagina].acessada) return;
+  self->versao_acesso++;
   self->tabela[pagina].acessada = false;
 }
 
@@ -135,3 +169,13 @@ err_t tabpag_traduz(tabpag_t *self, int pagina, int *pquadro)
   *pquadro = self->tabela[pagina].quadro;
   return ERR_OK;
 }
+
+unsigned tabpag_versao(tabpag_t *self)
+{
+  return self->versao;
+}
+
+unsigned tabpag_versao_acesso(tabpag_t *self)
+{
+  return self->versao_acesso;
+}
@@ -10,7 +10,8 @@
 // realiza a tradução de números de páginas do espaço de endereçamento
 //   de um processo em números de quadros da memória principal onde essas
 //   páginas estão mapeadas
-// mantém para cada página mapeada um bit de acesso e um bit de alteração
+// mantém para cada página mapeada um bit de acesso e um bit de alteração,
+//   e um bit de proteção contra escrita
 
 #include "err.h"
 #include <stdbool.h>
@@ -30,11 +31,20 @@ tabpag_t *tabpag_cria(void);
 void tabpag_destroi(tabpag_t *self);
 
 // define que a tradução da página 'pagina' deve resultar no quadro 'quadro'
-// essa página é marcada como válida, e os bits de acesso e alteração para essa
-//   página são zerados
+// essa página é marcada como válida, e os bits de acesso, alteração e
+//   proteção para essa página são zerados
 // páginas sem quadro definido são consideradas inválidas
 void tabpag_define_quadro(tabpag_t *self, int pagina, int quadro);
 
+// protege (ou desprotege) a página contra escrita; uma escrita em uma
+//   página protegida resulta em ERR_PAG_PROTEGIDA na MMU
+// não faz nada se a página for inválida
+void tabpag_protege_pagina(tabpag_t *self, int pagina, bool protegida);
+
+// retorna true se a página estiver protegida contra escrita
+// retorna false se a página for inválida
+bool tabpag_pagina_protegida(tabpag_t *self, int pagina);
+
 // marca a página 'pagina' como inválida.
 // as informações sobre essa página são perdidas.
 void tabpag_invalida_pagina(tabpag_t *self, int pagina);
@@ -61,4 +71,19 @@ bool tabpag_bit_alteracao(tabpag_t *self, int pagina);
 // retorna ERR_PAG_AUSENTE (e não altera '*pquadro') se a página for inválida
 err_t tabpag_traduz(tabpag_t *self, int pagina, int *pquadro);
 
+// retorna a versão da tabela
+// a versão muda sempre que uma tradução é alterada (tabpag_define_quadro,
+//   tabpag_invalida_pagina, tabpag_protege_pagina); quem guarda cópia de
+//   informações da tabela (a TLB da MMU) usa a versão para saber se a cópia
+//   ainda vale
+// versões são únicas entre todas as tabelas, uma tabela nova não repete a
+//   versão de uma tabela destruída
+unsigned tabpag_versao(tabpag_t *self);
+
+// retorna a versão dos bits de acesso da tabela, que muda sempre que um bit
+//   de acesso é zerado (tabpag_zera_bit_acesso)
+// as traduções não mudam com isso; quem lembra que já marcou o acesso a uma
+//   página (a TLB) usa essa versão para saber se precisa marcar de novo
+unsigned tabpag_versao_acesso(tabpag_t *self);
+
 #endif // TABPAG_H
@@ -17,21 +17,26 @@ struct terminal_t {
   int tam_linha;
   // texto já digitado no terminal, esperando para ser lido
   char *entrada;
-  // texto sendo mostrado na saída do terminal
-  char *saida;
-  // normal: aceitando novos caracteres na saída
-  // rolando: removendo um caractere no início para gerar espaço.
-  //   move um caractere por vez para a esquerda, até chegar no final
-  //   da linha.
-  //   entra neste estado quando recebe um caractere na última posição.
-  //   não aceita novos caracteres
-  // limpando: removendo um caractere no início da linha por vez, até
-  //   ficar com a linha vazia.
-  //   entra nesse estado quando recebe um '\n'.
-  //   não aceita novos caracteres
-  enum { normal, rolando, limpando } estado_saida;
-  // posicao do caractere que está sendo movido durante uma rolagem
-  int pos_rolagem;
+  // linhas de saída, em um buffer circular com N_HISTORICO linhas de
+  //   tam_linha caracteres (mais o '\0'); a linha 'atual' é a que está sendo
+  //   mostrada, e tem 'tam_atual' caracteres
+  char *historico;
+  int atual;
+  int n_linhas;
+  int tam_atual;
+  // cada caractere escrito deixa a saída ocupada por 'tempo_char' chamadas a
+  //   tictac; 't_ocupada' é quanto ainda falta (0 se aceita caracteres)
+  int tempo_char;
+  int t_ocupada;
+  // arquivo que alimenta a entrada e arquivo que recebe cópia da saída
+  //   (NULL se não houver)
+  FILE *arq_entrada;
+  FILE *arq_saida;
+  // muda a cada alteração na entrada ou na saída
+  unsigned versao;
+  // interrupções pendentes, de teclado e de tela
+  bool int_teclado;
+  bool int_tela;
 };
 
 
@@ -40,14 +45,23 @@ terminal_t *terminal_cria(int tam_linha)
   terminal_t *self = malloc(sizeof(*self));
   assert(self != NULL);
 
-  self->saida = malloc(tam_linha + 1);
+  self->historico = malloc(N_HISTORICO * (tam_linha + 1));
   self->entrada = malloc(tam_linha + 1);
-  assert(self->saida != NULL && self->entrada != NULL);
+  assert(self->historico != NULL && self->entrada != NULL);
 
   self->tam_linha = tam_linha;
   strcpy(self->entrada, "");
-  strcpy(self->saida, "");
-  self->estado_saida = normal;
+  self->atual = 0;
+  self->n_linhas = 1;
+  self->tam_atual = 0;
+  self->historico[0] = '\0';
+  self->tempo_char = 0;
+  self->t_ocupada = 0;
+  self->arq_entrada = NULL;
+  self->arq_saida = NULL;
+  self->int_teclado = false;
+  self->int_tela = false;
+  self->versao = 0;
 
   return self;
 }
@@ -55,7 +69,7 @@ terminal_t *terminal_cria(int tam_linha)
 void terminal_destroi(terminal_t *self)
 {
   free(self->entrada);
-  free(self->saida);
+  free(self->historico);
   free(self);
 }
 
@@ -70,6 +84,7 @@ static char terminal_le_char(terminal_t *self)
   char ch = p[0];
   if (ch != '\0') {
     memmove(&p[0], &p[1], strlen(p));
+    self->versao++;
   }
   return ch;
 }
@@ -82,75 +97,145 @@ void terminal_insere_char(terminal_t *self, char ch)
   if (tam >= self->tam_linha-2) return;
   p[tam] = ch;
   p[tam+1] = '\0';
+  self->int_teclado = true;
+  self->versao++;
+}
+
+bool terminal_interrupcao(terminal_t *self, irq_t irq)
+{
+  switch (irq) {
+    case IRQ_TECLADO: return self->int_teclado;
+    case IRQ_TELA:    return self->int_tela;
+    default:          return false;
+  }
+}
+
+void terminal_reconhece_interrupcao(terminal_t *self, irq_t irq)
+{
+  switch (irq) {
+    case IRQ_TECLADO: self->int_teclado = false; break;
+    case IRQ_TELA:    self->int_tela = false;    break;
+    default:          break;
+  }
+}
+
+// a saída volta a aceitar caracteres; avisa com uma interrupção
+static void terminal_saida_livre(terminal_t *self)
+{
+  self->t_ocupada = 0;
+  self->int_tela = true;
+}
+
+void terminal_define_tempo_por_char(terminal_t *self, int tempo)
+{
+  self->tempo_char = tempo < 0 ? 0 : tempo;
+}
+
+void terminal_define_arquivos(terminal_t *self, FILE *entrada, FILE *saida)
+{
+  self->arq_entrada = entrada;
+  self->arq_saida = saida;
+}
+
+// transfere um caractere do arquivo de entrada para a entrada do terminal,
+//   se tiver arquivo e espaço para o caractere
+static void terminal_alimenta_entrada(terminal_t *self)
+{
+  if (self->arq_entrada == NULL) return;
+  if (strlen(self->entrada) >= self->tam_linha-2) return;
+  int ch = fgetc(self->arq_entrada);
+  if (ch == EOF) {
+    self->arq_entrada = NULL;
+    return;
+  }
+  terminal_insere_char(self, ch);
 }
 
 static bool terminal_pode_imprimir(terminal_t *self)
 {
-  return self->estado_saida == normal;
+  return self->t_ocupada == 0;
+}
+
+// a linha que está 'n' linhas antes da atual no histórico
+static char *terminal_linha(terminal_t *self, int n)
+{
+  int l = (self->atual - n + N_HISTORICO) % N_HISTORICO;
+  return &self->historico[l * (self->tam_linha + 1)];
+}
+
+// passa para uma nova linha de saída, vazia; a mais antiga do histórico é
+//   perdida se ele estiver cheio
+static void terminal_nova_linha(terminal_t *self)
+{
+  self->atual = (self->atual + 1) % N_HISTORICO;
+  if (self->n_linhas < N_HISTORICO) self->n_linhas++;
+  self->tam_atual = 0;
+  terminal_linha(self, 0)[0] = '\0';
 }
 
 static void terminal_imprime(terminal_t *self, char ch)
 {
-  if (terminal_pode_imprimir(self)) {
-    if (ch == '\n') {
-      self->estado_saida = limpando;
-      return;
-    }
-    int tam = strlen(self->saida);
-    self->saida[tam] = ch;
-    tam++;
-    self->saida[tam] = '\0';
-    if (tam >= self->tam_linha - 1) {
-      self->estado_saida = rolando;
-      self->pos_rolagem = 0;
-    }
+  if (self->arq_saida != NULL) {
+    fputc(ch, self->arq_saida);
+  }
+  if (self->tempo_char > 0) {
+    self->t_ocupada = self->tempo_char;
+  }
+  self->versao++;
+  if (ch == '\n') {
+    terminal_nova_linha(self);
+    return;
   }
+  if (self->tam_atual >= self->tam_linha - 1) {
+    terminal_nova_linha(self);
+  }
+  char *linha = terminal_linha(self, 0);
+  linha[self->tam_atual++] = ch;
+  linha[self->tam_atual] = '\0';
 }
 
 void terminal_limpa_saida(terminal_t *self)
 {
-  self->saida[0] = '\0';
-  self->estado_saida = normal;
+  self->versao++;
+  self->tam_atual = 0;
+  terminal_linha(self, 0)[0] = '\0';
+  if (!terminal_pode_imprimir(self)) terminal_saida_livre(self);
 }
 
-static void terminal_atualiza_rolagem(terminal_t *self)
+// conta o tempo em que a saída está ocupada, e alimenta a entrada com o
+//   arquivo de entrada, se houver
+void terminal_tictac(terminal_t *self)
 {
-  // remove o caractere na posição de rolagem e avança
-  // se chegou no final da string, terminou a rolagem
-  char *p = self->saida;
-  p[self->pos_rolagem] = p[self->pos_rolagem + 1];
-  if (p[self->pos_rolagem] != '\0') {
-    self->pos_rolagem++;
-    p[self->pos_rolagem] = ' ';
-  } else {
-    self->estado_saida = normal;
+  terminal_alimenta_entrada(self);
+  if (self->t_ocupada > 0) {
+    self->t_ocupada--;
+    if (self->t_ocupada == 0) terminal_saida_livre(self);
   }
 }
 
-static void terminal_atualiza_limpeza(terminal_t *self)
+// se uma chamada a tictac não alteraria o terminal
+static bool terminal_ocioso(terminal_t *self)
 {
-  // remove um caractere do início da string; volta ao estado normal se era o último
-  char *p = self->saida;
-  int tam = strlen(p);
-  memmove(p, p+1, tam);
-  if (tam <= 1) {
-    self->estado_saida = normal;
+  if (self->t_ocupada > 0) return false;
+  if (self->arq_entrada == NULL) return true;
+  return strlen(self->entrada) >= self->tam_linha-2;
+}
+
+void terminal_avanca(terminal_t *self, int n)
+{
+  for (int i = 0; i < n && !terminal_ocioso(self); i++) {
+    terminal_tictac(self);
   }
 }
 
-// altera a string de saída em 1 caractere, se estiver rolando ou limpando
-void terminal_tictac(terminal_t *self)
+int terminal_tempo_ate_evento(terminal_t *self)
 {
-  switch (self->estado_saida) {
-    case normal: 
-      break;
-    case rolando:
-      terminal_atualiza_rolagem(self);
-      break;
-    case limpando:
-      terminal_atualiza_limpeza(self);
-      break;
+  if (terminal_ocioso(self)) return 0;
+  // a entrada é alimentada a cada tictac
+  if (self->arq_entrada != NULL && strlen(self->entrada) < self->tam_linha-2) {
+    return 1;
   }
+  return self->t_ocupada;
 }
 
 char *terminal_txt_entrada(terminal_t *self)
@@ -158,9 +243,20 @@ char *terminal_txt_entrada(terminal_t *self)
   return self->entrada;
 }
 
+unsigned terminal_versao(terminal_t *self)
+{
+  return self->versao;
+}
+
 char *terminal_txt_saida(terminal_t *self)
 {
-  return self->saida;
+  return terminal_linha(self, 0);
+}
+
+char *terminal_txt_historico(terminal_t *self, int n)
+{
+  if (n < 0 || n >= self->n_linhas) return NULL;
+  return terminal_linha(self, n);
 }
 
 // Operações de leitura e escrita no terminal, chamadas pelo controlador de E/S
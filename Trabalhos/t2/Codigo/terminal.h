@@ -8,8 +8,9 @@
 
 // simulação de um terminal
 //
-// mantém o conteúdo da linha de saída de um terminal (o que aparece na tela) e
-// da linha de entrada (o que foi digitado e ainda não foi lido pela CPU)
+// mantém o conteúdo da linha de saída de um terminal (o que aparece na tela),
+// das últimas linhas de saída (o histórico) e da linha de entrada (o que foi
+// digitado e ainda não foi lido pela CPU)
 //
 // implementa 4 dispositivos associados a um terminal:
 // - leitura do próximo caractere de entrada
@@ -21,18 +22,34 @@
 // existe um limite para caracteres digitados e não lidos; caracteres adicionais
 //   são ignorados
 // o número de caracteres na saída é limitado ao tamanho da linha. um caractere
-//   adicional causa a "rolagem", que remove o primeiro caractere da linha para
-//   gerar espaço para o novo. a impressão de um \n causa a "limpeza" da linha.
-// a escrita não é possível se a saída estiver rolando ou sendo limpa, o que é
-//   feito um caractere por vez (a cada chamada a tictac).
+//   adicional ou a impressão de um \n passa para uma nova linha; a anterior vai
+//   para o histórico, que guarda as últimas N_HISTORICO linhas.
+// por padrão a saída aceita um caractere a qualquer momento. opcionalmente, a
+//   velocidade da saída pode ser limitada: cada caractere deixa a saída ocupada
+//   durante um certo número de chamadas a tictac, e a escrita não é possível
+//   enquanto ela estiver ocupada (ver terminal_define_tempo_por_char).
 //
 // a E/S efetiva é realizada pela console. ela obtém acesso às linhas de entrada e
 //   saída chamando terminal_txt_entrada ou terminal_txt_saida. a console insere
 //   caracteres digitados no terminal chamando terminal_insere_char, e limpa a
 //   linha de saída com terminal_limpa_saida.
+//
+// o terminal gera interrupções: IRQ_TECLADO quando um caractere é inserido na
+//   entrada e IRQ_TELA quando a saída volta a aceitar caracteres depois de
+//   ficar ocupada. A interrupção fica pendente até ser reconhecida
+//   (ver terminal_interrupcao e terminal_reconhece_interrupcao).
+//
+// para execução sem tela (modo lote), a entrada do terminal pode ser alimentada
+//   por um arquivo e a saída pode ser copiada para um arquivo (ver
+//   terminal_define_arquivos).
 
 #include <stdbool.h>
+#include <stdio.h>
 #include "es.h"
+#include "irq.h"
+
+// número de linhas de saída guardadas no histórico (incluindo a atual)
+#define N_HISTORICO 100
 
 typedef struct terminal_t terminal_t;
 
@@ -47,6 +64,18 @@ char *terminal_txt_entrada(terminal_t *self);
 // retorna a linha de saida do terminal (para uso pela console)
 char *terminal_txt_saida(terminal_t *self);
 
+// retorna a linha de saída que está 'n' linhas antes da atual (0 é a atual),
+//   ou NULL se o histórico não tiver essa linha
+char *terminal_txt_historico(terminal_t *self, int n);
+
+// define a velocidade da saída: cada caractere escrito deixa a saída ocupada
+//   por 'tempo' chamadas a tictac (com 0, o padrão, a saída nunca fica ocupada)
+void terminal_define_tempo_por_char(terminal_t *self, int tempo);
+
+// retorna um número que muda cada vez que a linha de entrada ou a de saída
+//   muda (para a console saber se precisa redesenhar o terminal)
+unsigned terminal_versao(terminal_t *self);
+
 // insere um novo caractere na entrada do terminal
 // (para uso pela console, para simular um caractere digitado no teclado)
 void terminal_insere_char(terminal_t *self, char ch);
@@ -54,9 +83,32 @@ void terminal_insere_char(terminal_t *self, char ch);
 // limpa a linha de saída (para uso pela console)
 void terminal_limpa_saida(terminal_t *self);
 
+// define arquivos associados ao terminal (qualquer um pode ser NULL)
+// os caracteres de 'entrada' são inseridos na entrada do terminal, um a cada
+//   chamada a tictac, quando houver espaço
+// os caracteres impressos na saída do terminal são também escritos em 'saida'
+// os arquivos não pertencem ao terminal, quem abriu deve fechar
+void terminal_define_arquivos(terminal_t *self, FILE *entrada, FILE *saida);
+
+// retorna true se o terminal tem uma interrupção 'irq' (IRQ_TECLADO ou
+//   IRQ_TELA) pendente
+bool terminal_interrupcao(terminal_t *self, irq_t irq);
+
+// reconhece a interrupção 'irq', que deixa de estar pendente
+void terminal_reconhece_interrupcao(terminal_t *self, irq_t irq);
+
 // esta função deve ser chamada periodicamente
 void terminal_tictac(terminal_t *self);
 
+// equivale a chamar terminal_tictac 'n' vezes
+// para antes se o terminal não tiver mais o que fazer (a saída não está
+//   ocupada e não há entrada a alimentar)
+void terminal_avanca(terminal_t *self, int n);
+
+// retorna em quantas chamadas a tictac o terminal vai mudar sozinho (a saída
+//   fica livre ou a entrada recebe um caractere do arquivo), 0 se não vai
+int terminal_tempo_ate_evento(terminal_t *self);
+
 // Funções para implementar o protocolo de acesso a um dispositivo pelo
 //   controlador de E/S
 // Devem seguir o protocolo f_leitura_t e f_escrita_t declarados em es.h